@@ -0,0 +1,245 @@
+/*
+
+  Stanford Engineers for a Sustainable World
+  Remote Monitoring System | August 2018
+
+  File: acquisition.cpp
+  --------------------------
+  Implementation of acquisition.h
+
+*/
+#include "application.h"
+#include "acquisition.h"
+
+static const double channel_delay = 3.2; // us, 84 sampling and 12 conversion cycles of a 30 MHz ADC clock
+
+Acquisition::Acquisition() {
+    channels = 0;
+    interval = 1;
+    half = 0;
+    overrun = false;
+    failure = false;
+    timeouts = 0;
+}
+
+void Acquisition::begin(const int *pins, unsigned int channels, unsigned int interval) {
+    this->channels = channels > max_channels ? max_channels : channels;
+    this->interval = interval > 0 ? interval : 1;
+    failure = false;
+    timeouts = 0;
+    for(unsigned int j = 0; j < this->channels; j++) {
+        this->pins[j] = pins[j];
+    }
+}
+
+unsigned int Acquisition::getInterval() {
+    return interval;
+}
+
+double Acquisition::getChannelDelay() {
+    return channel_delay;
+}
+
+bool Acquisition::overran() {
+    return overrun;
+}
+
+bool Acquisition::failed() {
+    return failure;
+}
+
+bool Acquisition::disabled() {
+    return timeouts >= max_timeouts;
+}
+
+#ifdef PLATFORM_ID
+
+void Acquisition::start() {
+    half = 0;
+    overrun = false;
+    failure = false;
+
+    analogRead(pins[0]); // So Particle has set the ADC up before its setup is saved
+    saved.adcCommon = ADC->CCR;
+    saved.adc[0] = ADC1->CR1;
+    saved.adc[1] = ADC1->CR2;
+    saved.adc[2] = ADC1->SMPR1;
+    saved.adc[3] = ADC1->SMPR2;
+    saved.adc[4] = ADC1->SQR1;
+    saved.adc[5] = ADC1->SQR2;
+    saved.adc[6] = ADC1->SQR3;
+    saved.dma[0] = DMA2_Stream0->CR;
+    saved.dma[1] = DMA2_Stream0->NDTR;
+    saved.dma[2] = DMA2_Stream0->PAR;
+    saved.dma[3] = DMA2_Stream0->M0AR;
+    saved.dma[4] = DMA2_Stream0->FCR;
+    saved.timer[0] = TIM3->CR1;
+    saved.timer[1] = TIM3->CR2;
+    saved.timer[2] = TIM3->PSC;
+    saved.timer[3] = TIM3->ARR;
+
+    RCC_APB2PeriphClockCmd(RCC_APB2Periph_ADC1, ENABLE);
+    RCC_AHB1PeriphClockCmd(RCC_AHB1Periph_DMA2, ENABLE);
+    RCC_APB1PeriphClockCmd(RCC_APB1Periph_TIM3, ENABLE);
+    for(unsigned int j = 0; j < channels; j++) {
+        pinMode(pins[j], AN_INPUT);
+    }
+
+    // Update events every interval us, timers on APB1 run at half the core clock
+    TIM_Cmd(TIM3, DISABLE);
+    TIM_TimeBaseInitTypeDef timer;
+    TIM_TimeBaseStructInit(&timer);
+    timer.TIM_Prescaler = SystemCoreClock / 2 / 1000000 - 1;
+    timer.TIM_Period = interval - 1;
+    timer.TIM_CounterMode = TIM_CounterMode_Up;
+    TIM_TimeBaseInit(TIM3, &timer);
+    TIM_SelectOutputTrigger(TIM3, TIM_TRGOSource_Update);
+
+    ADC_Cmd(ADC1, DISABLE);
+    DMA_Cmd(DMA2_Stream0, DISABLE);
+    waitDisabled();
+    DMA_ClearFlag(DMA2_Stream0, DMA_FLAG_HTIF0 | DMA_FLAG_TCIF0 | DMA_FLAG_TEIF0 | DMA_FLAG_DMEIF0 | DMA_FLAG_FEIF0);
+    DMA_InitTypeDef dma;
+    DMA_StructInit(&dma);
+    dma.DMA_Channel = DMA_Channel_0;
+    dma.DMA_PeripheralBaseAddr = (uint32_t)&ADC1->DR;
+    dma.DMA_Memory0BaseAddr = (uint32_t)buffer;
+    dma.DMA_DIR = DMA_DIR_PeripheralToMemory;
+    dma.DMA_BufferSize = 2 * block_scans * channels;
+    dma.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+    dma.DMA_MemoryInc = DMA_MemoryInc_Enable;
+    dma.DMA_PeripheralDataSize = DMA_PeripheralDataSize_HalfWord;
+    dma.DMA_MemoryDataSize = DMA_MemoryDataSize_HalfWord;
+    dma.DMA_Mode = DMA_Mode_Circular;
+    dma.DMA_Priority = DMA_Priority_High;
+    DMA_Init(DMA2_Stream0, &dma);
+    DMA_Cmd(DMA2_Stream0, ENABLE);
+
+    ADC_CommonInitTypeDef common;
+    ADC_CommonStructInit(&common);
+    common.ADC_Mode = ADC_Mode_Independent;
+    common.ADC_Prescaler = ADC_Prescaler_Div2;
+    ADC_CommonInit(&common);
+
+    ADC_InitTypeDef adc;
+    ADC_StructInit(&adc);
+    adc.ADC_Resolution = ADC_Resolution_12b;
+    adc.ADC_ScanConvMode = ENABLE;
+    adc.ADC_ContinuousConvMode = DISABLE;
+    adc.ADC_ExternalTrigConvEdge = ADC_ExternalTrigConvEdge_Rising;
+    adc.ADC_ExternalTrigConv = ADC_ExternalTrigConv_T3_TRGO;
+    adc.ADC_DataAlign = ADC_DataAlign_Right;
+    adc.ADC_NbrOfConversion = channels;
+    ADC_Init(ADC1, &adc);
+    for(unsigned int j = 0; j < channels; j++) {
+        ADC_RegularChannelConfig(ADC1, HAL_Pin_Map()[pins[j]].adc_channel, j + 1, ADC_SampleTime_84Cycles);
+    }
+    ADC_DMARequestAfterLastTransferCmd(ADC1, ENABLE);
+    ADC_DMACmd(ADC1, ENABLE);
+    ADC_Cmd(ADC1, ENABLE);
+
+    TIM_SetCounter(TIM3, 0);
+    TIM_Cmd(TIM3, ENABLE);
+}
+
+// Half transfer means the first half is full, transfer complete the second. A block normally takes
+// block_scans intervals, the first one of a capture up to twice that
+const uint16_t *Acquisition::nextBlock() {
+    uint32_t flag = half == 0 ? DMA_FLAG_HTIF0 : DMA_FLAG_TCIF0;
+    uint32_t other = half == 0 ? DMA_FLAG_TCIF0 : DMA_FLAG_HTIF0;
+    unsigned long timeout = 4 * block_scans * interval;
+    unsigned long start = micros();
+    while(DMA_GetFlagStatus(DMA2_Stream0, flag) == RESET) {
+        if(micros() - start > timeout) {
+            failure = true;
+            return nullptr;
+        }
+    }
+    DMA_ClearFlag(DMA2_Stream0, flag);
+    if(DMA_GetFlagStatus(DMA2_Stream0, other) == SET) {
+        overrun = true; // The other half filled again before it was read
+    }
+    const uint16_t *block = buffer + half * block_scans * channels;
+    half ^= 1;
+    return block;
+}
+
+void Acquisition::stop() {
+    TIM_Cmd(TIM3, DISABLE);
+    ADC_Cmd(ADC1, DISABLE);
+    ADC_DMACmd(ADC1, DISABLE);
+    DMA_Cmd(DMA2_Stream0, DISABLE);
+    waitDisabled();
+    DMA_ClearFlag(DMA2_Stream0, DMA_FLAG_HTIF0 | DMA_FLAG_TCIF0 | DMA_FLAG_TEIF0 | DMA_FLAG_DMEIF0 | DMA_FLAG_FEIF0);
+
+    ADC->CCR = saved.adcCommon;
+    ADC1->CR1 = saved.adc[0];
+    ADC1->SMPR1 = saved.adc[2];
+    ADC1->SMPR2 = saved.adc[3];
+    ADC1->SQR1 = saved.adc[4];
+    ADC1->SQR2 = saved.adc[5];
+    ADC1->SQR3 = saved.adc[6];
+    ADC1->CR2 = saved.adc[1];
+    DMA2_Stream0->NDTR = saved.dma[1];
+    DMA2_Stream0->PAR = saved.dma[2];
+    DMA2_Stream0->M0AR = saved.dma[3];
+    DMA2_Stream0->FCR = saved.dma[4];
+    DMA2_Stream0->CR = saved.dma[0] & ~DMA_SxCR_EN;
+    TIM3->PSC = saved.timer[2];
+    TIM3->ARR = saved.timer[3];
+    TIM3->CR2 = saved.timer[1];
+    TIM3->CR1 = saved.timer[0];
+    timeouts = failure ? timeouts + 1 : 0;
+}
+
+// The stream finishes the transfer in progress before it reads as disabled
+bool Acquisition::waitDisabled() {
+    unsigned long start = micros();
+    while(DMA_GetCmdStatus(DMA2_Stream0) != DISABLE) {
+        if(micros() - start > disable_timeout) {
+            failure = true;
+            return false;
+        }
+    }
+    return true;
+}
+
+#else
+
+void Acquisition::start() {
+    half = 0;
+    overrun = false;
+    failure = false;
+    blockStart = HostHal::micros();
+}
+
+// Takes the block at the instants the timer would have triggered it, and moves the clock to its end.
+// A board set to stall waits out the Electron's timeout instead
+const uint16_t *Acquisition::nextBlock() {
+    if(HostHal::board().acquisitionStalls) {
+        HostHal::advance(4 * block_scans * interval);
+        failure = true;
+        return nullptr;
+    }
+    uint16_t *block = buffer + half * block_scans * channels;
+    for(unsigned int k = 0; k < block_scans; k++) {
+        double t = blockStart + (double)k * interval;
+        for(unsigned int j = 0; j < channels; j++) {
+            block[k * channels + j] = HostHal::sampleAt(pins[j], t + j * channel_delay);
+        }
+    }
+    blockStart += (double)block_scans * interval;
+    if(HostHal::micros() > blockStart + (double)block_scans * interval) {
+        overrun = true; // Would have been overwritten by now
+    } else if(HostHal::micros() < blockStart) {
+        HostHal::advance((uint64_t)(blockStart - HostHal::micros()));
+    }
+    half ^= 1;
+    return block;
+}
+
+void Acquisition::stop() {
+    timeouts = failure ? timeouts + 1 : 0;
+}
+
+#endif
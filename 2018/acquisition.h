@@ -0,0 +1,81 @@
+/*
+
+  Stanford Engineers for a Sustainable World
+  Remote Monitoring System | August 2018
+
+  File: acquisition.h
+  --------------------------
+  Hardware-timed capture of every recorded input. A timer triggers one ADC scan of all the channels
+  each interval, and DMA writes the scans into a buffer split into two halves, so one half can be
+  read while the other fills. Samples are spaced exactly interval us apart, the channels of a scan a
+  few us apart, and the CPU is free between blocks instead of waiting on analogRead().
+
+  The halves only overlap the per-sample work of the same capture (smoothing, power sums, crossings),
+  Sensors still fits the whole capture after stop(). Capturing the next window during the fits would
+  need a second 16 KB sample buffer the Electron does not have room for, and measurements are taken
+  once per measurement_frequency (transmitter.h) anyway, so capture is not gap-free. Between captures
+  GeneratorMonitor only watches whether the generator is running.
+
+  On the Electron (STM32F205) TIM3 triggers ADC1 in scan mode and DMA2 stream 0 runs circularly over
+  both halves. Particle's analogRead() uses the same ADC and stream, so start() saves their registers
+  and stop() restores them. TIM3 also drives PWM on some pins, which can not be used alongside it.
+  Every wait on the DMA is bounded. One that times out makes failed() true for that capture, and Sensors
+  takes it again with analogRead() instead of hanging the board. The next capture tries the DMA again,
+  only max_timeouts captures failing in a row make disabled() true, and that lasts until the next begin().
+  The host build fills the blocks from the simulated board at the same instants.
+
+*/
+
+#ifndef ACQUISITION_H
+#define ACQUISITION_H
+
+#include <stdint.h>
+
+class Acquisition {
+public:
+/**********************************  SETUP  ***********************************/
+  Acquisition();
+
+/********************************  FUNCTIONS  *********************************/
+  void    begin(const int *pins, unsigned int channels, unsigned int interval); // interval in us
+  void    start();
+  const uint16_t *  nextBlock(); // Waits for the next block_scans scans, channels interleaved in pin order, nullptr if they never came
+  void    stop();
+  unsigned int  getInterval(); // us between scans
+  double  getChannelDelay(); // us between the channels of a scan
+  bool    overran(); // A block was overwritten before it was read since start()
+  bool    failed(); // A wait on the DMA timed out since start()
+  bool    disabled(); // The last max_timeouts captures failed(), until the next begin()
+
+  static const unsigned int max_channels = 4;
+  static const unsigned int block_scans = 50;
+  static const unsigned long disable_timeout = 1000; // us for the stream to stop, a beat or two of the bus
+  static const unsigned int max_timeouts = 3;
+
+private:
+/*********************************  OBJECTS  **********************************/
+  int pins[max_channels];
+  unsigned int channels;
+  unsigned int interval;
+  unsigned int half; // Half nextBlock() returns next
+  bool overrun;
+  bool failure;
+  unsigned int timeouts; // Captures in a row that failed
+  uint16_t buffer[2 * block_scans * max_channels]; // Two halves of block_scans * channels
+
+  #ifdef PLATFORM_ID
+    bool    waitDisabled();
+
+    struct Registers { // What analogRead() had set up
+      uint32_t  adcCommon;
+      uint32_t  adc[7]; // CR1, CR2, SMPR1, SMPR2, SQR1, SQR2, SQR3
+      uint32_t  dma[5]; // CR, NDTR, PAR, M0AR, FCR
+      uint32_t  timer[4]; // CR1, CR2, PSC, ARR
+    };
+    Registers saved;
+  #else
+    double blockStart; // us
+  #endif
+};
+
+#endif
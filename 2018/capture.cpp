@@ -0,0 +1,179 @@
+/*
+
+  Stanford Engineers for a Sustainable World
+  Remote Monitoring System | August 2018
+
+  File: capture.cpp
+  --------------------------
+  Implementation of capture.h
+
+*/
+
+#include "capture.h"
+#include "measurement_log.h"
+#include <string.h>
+
+static const uint8_t capture_magic[4] = {'S', 'C', 'A', 'P'};
+
+// Keeps the crc of everything passed through it
+struct CaptureWriter {
+  CaptureSink &out;
+  uint16_t crc;
+
+  void bytes(const uint8_t *data, unsigned int length) {
+    crc = MeasurementLog::crc16(data, length, crc);
+    out.write(data, length);
+  }
+  void u8(uint8_t v) {
+    bytes(&v, 1);
+  }
+  void u16(uint16_t v) {
+    uint8_t b[2] = {(uint8_t)v, (uint8_t)(v >> 8)};
+    bytes(b, 2);
+  }
+  void u32(uint32_t v) {
+    uint8_t b[4] = {(uint8_t)v, (uint8_t)(v >> 8), (uint8_t)(v >> 16), (uint8_t)(v >> 24)};
+    bytes(b, 4);
+  }
+  void f32(float v) {
+    uint32_t u;
+    memcpy(&u, &v, 4);
+    u32(u);
+  }
+};
+
+static uint16_t getU16(const uint8_t *p) {
+  return p[0] | (p[1] << 8);
+}
+
+static uint32_t getU32(const uint8_t *p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static float getF32(const uint8_t *p) {
+  uint32_t u = getU32(p);
+  float v;
+  memcpy(&v, &u, 4);
+  return v;
+}
+
+static unsigned int packedSize(unsigned int count) {
+  return count / 2 * 3 + (count % 2) * 2;
+}
+
+static uint16_t toCounts(sample_t x) {
+  return SampleTraits<uint16_t>::fromDouble(x);
+}
+
+unsigned int captureSize(const Capture &capture) {
+  return capture_header_size + capture.channels * (capture_channel_size + packedSize(capture.count)) + 2;
+}
+
+void writeCapture(CaptureSink &out, const Capture &capture) {
+  CaptureWriter w = {out, 0xFFFF};
+  w.bytes(capture_magic, 4);
+  w.u8(capture_version);
+  w.u8(capture.channels);
+  w.u8(capture.flags);
+  w.u8(0);
+  w.u16(capture.count);
+  w.u16(0);
+  w.u32((uint32_t)(capture.interval * 1000 + .5));
+  w.u32((uint32_t)(capture.channelDelay * 1000 + .5));
+  w.u32(capture.time);
+  w.u32(capture.period);
+  for(unsigned int i = 0; i < capture.channels; i++) {
+    const CaptureChannel &c = capture.channel[i];
+    w.u8(c.input);
+    w.u8(c.pin);
+    w.u8(c.flags);
+    w.u8(0);
+    w.u16(c.yShift);
+    w.u16(c.waveMin);
+    w.u16(c.waveMax);
+    w.u16(0);
+    w.f32(c.a);
+    w.f32(c.b);
+    w.f32(c.c);
+    w.f32(c.maxError);
+    w.u32(c.amplitude);
+    w.u16(c.xShift);
+    w.u16(0);
+    w.f32(c.error);
+  }
+  for(unsigned int i = 0; i < capture.channels; i++) {
+    const sample_t *x = capture.channel[i].samples;
+    unsigned int j = 0;
+    for(; j + 1 < capture.count; j += 2) {
+      uint16_t a = toCounts(x[j]), b = toCounts(x[j + 1]);
+      uint8_t packed[3] = {(uint8_t)a, (uint8_t)((a >> 8) | (b << 4)), (uint8_t)(b >> 4)};
+      w.bytes(packed, 3);
+    }
+    if(j < capture.count) {
+      w.u16(toCounts(x[j]));
+    }
+  }
+  uint16_t crc = w.crc;
+  w.u16(crc);
+}
+
+unsigned int readCapture(const uint8_t *data, unsigned int length, Capture &capture, sample_t *storage, unsigned int storageSize) {
+  if(length < capture_header_size + 2 || memcmp(data, capture_magic, 4) != 0 || data[4] != capture_version) {
+    return 0;
+  }
+  capture.version = data[4];
+  capture.channels = data[5];
+  capture.flags = data[6];
+  capture.count = getU16(data + 8);
+  capture.interval = getU32(data + 12) / 1000.;
+  capture.channelDelay = getU32(data + 16) / 1000.;
+  capture.time = getU32(data + 20);
+  capture.period = getU32(data + 24);
+  if(capture.channels > capture_max_channels || capture.channels * capture.count > storageSize) {
+    return 0;
+  }
+  unsigned int size = captureSize(capture);
+  if(length < size || getU16(data + size - 2) != MeasurementLog::crc16(data, size - 2)) {
+    return 0;
+  }
+  const uint8_t *p = data + capture_header_size;
+  for(unsigned int i = 0; i < capture.channels; i++, p += capture_channel_size) {
+    CaptureChannel &c = capture.channel[i];
+    c.input = p[0];
+    c.pin = p[1];
+    c.flags = p[2];
+    c.yShift = getU16(p + 4);
+    c.waveMin = getU16(p + 6);
+    c.waveMax = getU16(p + 8);
+    c.a = getF32(p + 12);
+    c.b = getF32(p + 16);
+    c.c = getF32(p + 20);
+    c.maxError = getF32(p + 24);
+    c.amplitude = getU32(p + 28);
+    c.xShift = getU16(p + 32);
+    c.error = getF32(p + 36);
+  }
+  for(unsigned int i = 0; i < capture.channels; i++) {
+    sample_t *x = storage + i * capture.count;
+    capture.channel[i].samples = x;
+    unsigned int j = 0;
+    for(; j + 1 < capture.count; j += 2, p += 3) {
+      x[j] = p[0] | ((p[1] & 0x0F) << 8);
+      x[j + 1] = (p[1] >> 4) | (p[2] << 4);
+    }
+    if(j < capture.count) {
+      x[j] = getU16(p);
+      p += 2;
+    }
+  }
+  return size;
+}
+
+int findCapture(const uint8_t *data, unsigned int length) {
+  for(unsigned int i = 0; i + 4 <= length; i++) {
+    if(memcmp(data + i, capture_magic, 4) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
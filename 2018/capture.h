@@ -0,0 +1,109 @@
+/*
+
+  Stanford Engineers for a Sustainable World
+  Remote Monitoring System | August 2018
+
+  File: capture.h
+  --------------------------
+  Binary format for one raw capture with everything needed to replay it: the samples, their spacing,
+  the channel configuration the board ran with and what the analysis made of them. The Electron
+  writes captures to Serial with DUMPCAPTURES (transmitter.h), host/replay runs them back through the
+  analysis and compares, and host/corpus holds a set of them as a regression suite.
+
+  Layout, multi-byte fields little endian, floats IEEE 754 single:
+    magic                   4 bytes, "SCAP"
+    version                 1 byte, capture_version
+    channels                1 byte, channel records that follow
+    flags                   1 byte, capture_valid | capture_generator_on | capture_fixed_point
+    reserved                1 byte, 0
+    count                   2 bytes, samples per channel
+    reserved                2 bytes, 0
+    interval                4 bytes, ns between samples
+    channel delay           4 bytes, ns between the reads of consecutive channels in a scan
+    time                    4 bytes, Unix time, 0 if unknown
+    period                  4 bytes, us, 0 if none was found
+    channel records         40 bytes each:
+      input, pin            1 byte each, index in site_channels and the pin it was read on
+      flags                 1 byte, capture_rectified | capture_ignored
+      reserved              1 byte, 0
+      yShift, waveMin, waveMax  2 bytes each, signed
+      reserved              2 bytes, 0
+      a, b, c, maxError     4 byte floats, calibration and fit limit
+      amplitude             4 bytes, fit, hundredths of ADC counts
+      xShift                2 bytes, fit phase in ten thousandths of a cycle
+      reserved              2 bytes, 0
+      error                 4 byte float, fit residual
+    samples                 per channel in record order, 12-bit samples packed two to three bytes,
+                            low bits first, an odd last sample takes two bytes
+    crc                     2 bytes, CRC-16/CCITT of everything before it
+
+  A 2000 sample, four channel capture is about 12 KB. A reader can find captures inside a serial log
+  by their magic and tell a damaged one by its crc.
+
+*/
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdint.h>
+#include "sample.h"
+
+static const uint8_t capture_version = 1;
+static const unsigned int capture_max_channels = 4;
+static const unsigned int capture_header_size = 28;
+static const unsigned int capture_channel_size = 40;
+
+enum CaptureFlags {
+  capture_valid = 1, // The fits were within maxError
+  capture_generator_on = 2,
+  capture_fixed_point = 4 // Analysed by the FIXED_POINT build
+};
+
+enum CaptureChannelFlags {
+  capture_rectified = 1,
+  capture_ignored = 2 // Read but not fit, e.g. the voltage of a site with no fitted inputs
+};
+
+struct CaptureChannel {
+  uint8_t   input;
+  uint8_t   pin;
+  uint8_t   flags;
+  int16_t   yShift;
+  int16_t   waveMin;
+  int16_t   waveMax;
+  float     a;
+  float     b;
+  float     c;
+  float     maxError;
+  uint32_t  amplitude;
+  uint16_t  xShift;
+  float     error;
+  const sample_t *  samples; // count of them
+};
+
+struct Capture {
+  uint8_t   version;
+  uint8_t   flags;
+  unsigned int  count;
+  double    interval; // us
+  double    channelDelay; // us
+  uint32_t  time;
+  uint32_t  period;
+  unsigned int  channels;
+  CaptureChannel  channel[capture_max_channels];
+};
+
+// Where writeCapture() puts the bytes, e.g. Serial on the Electron or a file on the host
+class CaptureSink {
+public:
+  virtual void  write(const uint8_t *data, unsigned int length) = 0;
+};
+
+void    writeCapture(CaptureSink &out, const Capture &capture); // Streams it, nothing the size of the samples is buffered
+unsigned int  captureSize(const Capture &capture);
+// Reads the capture at data, its samples go to storage which must hold channels * count of them.
+// Returns the bytes it took, 0 if there is no valid capture there.
+unsigned int  readCapture(const uint8_t *data, unsigned int length, Capture &capture, sample_t *storage, unsigned int storageSize);
+int     findCapture(const uint8_t *data, unsigned int length); // Offset of the next magic, -1 if there is none
+
+#endif
@@ -0,0 +1,73 @@
+/*
+
+  Stanford Engineers for a Sustainable World
+  Remote Monitoring System | August 2018
+
+  File: connection.cpp
+  --------------------------
+  Implementation of connection.h
+
+*/
+#include <string.h>
+#include "connection.h"
+
+static const uint32_t stats_magic = 0x53455357; // "SESW"
+
+Backoff::Backoff() {
+    begin(0, 0);
+}
+
+void Backoff::begin(unsigned long first, unsigned long max) {
+    interval = first;
+    this->max = max;
+}
+
+unsigned long Backoff::next() {
+    unsigned long wait = interval;
+    interval = interval > max / 2 ? max : interval * 2;
+    return wait;
+}
+
+void ConnectionStats::init() {
+    if(magic != stats_magic) {
+        memset(this, 0, sizeof(*this));
+        magic = stats_magic;
+    }
+}
+
+void ConnectionStats::recordSession(uint32_t onTime) {
+    sessions++;
+    this->onTime += onTime;
+}
+
+void ConnectionStats::recordCellular(uint32_t latency) {
+    cellularCount++;
+    cellularTotal += latency;
+    if(latency > cellularMax) {
+        cellularMax = latency;
+    }
+}
+
+void ConnectionStats::recordCloud(uint32_t latency) {
+    cloudCount++;
+    cloudTotal += latency;
+    if(latency > cloudMax) {
+        cloudMax = latency;
+    }
+}
+
+void ConnectionStats::recordCellularFailure() {
+    cellularFailures++;
+}
+
+void ConnectionStats::recordCloudFailure() {
+    cloudFailures++;
+}
+
+uint32_t ConnectionStats::meanCellular() const {
+    return cellularCount ? cellularTotal / cellularCount : 0;
+}
+
+uint32_t ConnectionStats::meanCloud() const {
+    return cloudCount ? cloudTotal / cloudCount : 0;
+}
@@ -0,0 +1,59 @@
+/*
+
+  Stanford Engineers for a Sustainable World
+  Remote Monitoring System | August 2018
+
+  File: connection.h
+  --------------------------
+  Helpers for the cellular session in transmitter.cpp. Backoff spaces out the Cellular.ready() and
+  Particle.connected() polls, starting fast so a quick link is noticed within a fraction of a second
+  and doubling up to a cap so a slow one is not polled needlessly. ConnectionStats keeps how long
+  this site takes to connect and how often it fails. It is plain data so it can live in retained
+  memory and survive the resets a failed connect ends in.
+
+*/
+
+#ifndef CONNECTION_H
+#define CONNECTION_H
+
+#include <stdint.h>
+
+class Backoff {
+public:
+/**********************************  SETUP  ***********************************/
+  Backoff();
+
+/********************************  FUNCTIONS  *********************************/
+  void    begin(unsigned long first, unsigned long max); // ms
+  unsigned long next(); // The wait before the next poll, doubling each call up to max
+
+private:
+/*********************************  OBJECTS  **********************************/
+  unsigned long interval;
+  unsigned long max;
+};
+
+struct ConnectionStats {
+  void    init(); // Keeps retained values from before a reset, clears anything else
+  void    recordSession(uint32_t onTime); // ms the modem was on
+  void    recordCellular(uint32_t latency); // ms from Cellular.connect() to ready
+  void    recordCloud(uint32_t latency); // ms from Particle.connect() to connected
+  void    recordCellularFailure();
+  void    recordCloudFailure();
+  uint32_t  meanCellular() const;
+  uint32_t  meanCloud() const;
+
+  uint32_t  magic;
+  uint32_t  sessions;
+  uint32_t  onTime; // ms, all sessions
+  uint32_t  cellularCount;
+  uint32_t  cellularTotal; // ms
+  uint32_t  cellularMax;
+  uint32_t  cellularFailures;
+  uint32_t  cloudCount;
+  uint32_t  cloudTotal;
+  uint32_t  cloudMax;
+  uint32_t  cloudFailures;
+};
+
+#endif
@@ -0,0 +1,91 @@
+/*
+
+  Stanford Engineers for a Sustainable World
+  Remote Monitoring System | August 2018
+
+  File: energy_ledger.cpp
+  --------------------------
+  Implementation of energy_ledger.h
+
+*/
+#include "application.h"
+#include <string.h>
+#include "energy_ledger.h"
+
+static const uint32_t ledger_magic = 0x4C454447; // "LEDG"
+static const unsigned int summary_version = 1;
+
+void EnergyLedger::init(const ConnectionStats &link, uint32_t now) {
+    if(magic != ledger_magic) {
+        clear(link, now);
+        return;
+    }
+    boots++;
+    sinceMillis = 0; // millis() started over
+}
+
+void EnergyLedger::clear(const ConnectionStats &link, uint32_t now) {
+    memset(this, 0, sizeof(*this));
+    magic = ledger_magic;
+    since = now;
+    sinceMillis = millis();
+    boots = 1;
+    linkAtStart = link;
+}
+
+void EnergyLedger::recordReset(Reset reason) {
+    resets[reason]++;
+    uptime += millis() - sinceMillis;
+    sinceMillis = 0;
+}
+
+void EnergyLedger::recordTask(int task, uint32_t busy) {
+    if(task >= 0 && task < (int)max_tasks) {
+        this->busy[task] += busy;
+    }
+}
+
+void EnergyLedger::recordSession(uint32_t onTime, uint32_t publishTime, uint32_t syncTime) {
+    sessions++;
+    this->onTime += onTime;
+    this->publishTime += publishTime;
+    this->syncTime += syncTime;
+}
+
+void EnergyLedger::recordPublish(unsigned int bytes, bool sent) {
+    if(sent) {
+        publishes++;
+        publishBytes += bytes;
+    } else {
+        failedPublishes++;
+    }
+}
+
+uint32_t EnergyLedger::elapsed(uint32_t now) const {
+    if(since != 0 && now >= since) {
+        return now - since;
+    }
+    return (uptime + (millis() - sinceMillis)) / 1000;
+}
+
+double EnergyLedger::estimateCharge(uint32_t now) const {
+    return (board_current * elapsed(now) + modem_current * onTime / 1000.) / 3600.;
+}
+
+bool EnergyLedger::appendSummary(PayloadWriter &out, const ConnectionStats &link, uint32_t now) const {
+    uint32_t cellularCount = link.cellularCount - linkAtStart.cellularCount;
+    uint32_t cloudCount = link.cloudCount - linkAtStart.cloudCount;
+    Payload<200> line;
+    line.appendf("L%u,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu", summary_version, (unsigned long)elapsed(now), (unsigned long)boots,
+        (unsigned long)resets[timer_reset], (unsigned long)resets[cellular_reset], (unsigned long)sessions,
+        (unsigned long)(onTime / 1000), (unsigned long)publishTime, (unsigned long)syncTime);
+    line.appendf(",%lu,%lu,%lu,%lu",
+        (unsigned long)(cellularCount ? (link.cellularTotal - linkAtStart.cellularTotal) / cellularCount : 0),
+        (unsigned long)(cloudCount ? (link.cloudTotal - linkAtStart.cloudTotal) / cloudCount : 0),
+        (unsigned long)(link.cellularFailures - linkAtStart.cellularFailures), (unsigned long)(link.cloudFailures - linkAtStart.cloudFailures));
+    line.appendf(",%lu,%lu,%lu,%.1f", (unsigned long)publishes, (unsigned long)failedPublishes, (unsigned long)publishBytes, estimateCharge(now));
+    for(unsigned int i = 0; i < max_tasks; i++) {
+        line.appendf(",%lu", (unsigned long)(busy[i] / 1000));
+    }
+    return !line.overflowed() && out.append(line.c_str());
+}
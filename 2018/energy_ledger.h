@@ -0,0 +1,68 @@
+/*
+
+  Stanford Engineers for a Sustainable World
+  Remote Monitoring System | August 2018
+
+  File: energy_ledger.h
+  --------------------------
+  What the board spent its battery on since the last summary: how long the modem was on and what for,
+  the CPU time of every scheduler task, what was published and how often the board reset itself.
+  Like ConnectionStats it is plain data for retained memory, so the resets a failed connect ends in
+  are counted instead of wiping it. Connect latencies and failures are already kept by ConnectionStats,
+  the ledger keeps a copy of it from its start and reports the difference.
+
+  The charge estimate takes Electron datasheet typicals, board_current all the time, since delay() does
+  not sleep, and modem_current on top while the modem is on. It is for comparing schedules, not a fuel
+  gauge. Time lost to a reset the ledger was not told about (watchdog, fault) is only counted when
+  the Unix time was known at both ends.
+
+  appendSummary() writes one line:
+    L1,<s covered>,<boots>,<timer resets>,<cellular resets>,<sessions>,<modem on s>,<publish ms>,<sync ms>,
+    <mean cellular ms>,<mean cloud ms>,<cellular failures>,<cloud failures>,<publishes>,<failed>,<bytes>,
+    <mAh>,<busy ms per task>
+
+*/
+
+#ifndef ENERGY_LEDGER_H
+#define ENERGY_LEDGER_H
+
+#include <stdint.h>
+#include "connection.h"
+#include "payload.h"
+#include "scheduler.h"
+
+struct EnergyLedger {
+  enum Reset { timer_reset, cellular_reset };
+
+  void    init(const ConnectionStats &link, uint32_t now); // Once per boot, keeps retained values from before a reset. now is Unix time or 0
+  void    clear(const ConnectionStats &link, uint32_t now); // Starts a new summary period
+  void    recordReset(Reset reason); // Call right before System.reset()
+  void    recordTask(int task, uint32_t busy); // us a scheduler task step took
+  void    recordSession(uint32_t onTime, uint32_t publishTime, uint32_t syncTime); // ms
+  void    recordPublish(unsigned int bytes, bool sent);
+  uint32_t  elapsed(uint32_t now) const; // s since the period started
+  double  estimateCharge(uint32_t now) const; // mAh since the period started
+  bool    appendSummary(PayloadWriter &out, const ConnectionStats &link, uint32_t now) const; // False if it did not fit
+
+  static constexpr double board_current = 47; // mA, STM32 running with the modem off
+  static constexpr double modem_current = 180; // mA more while the modem is on, 3G average
+  static const unsigned int max_tasks = Scheduler::max_tasks;
+
+  uint32_t  magic;
+  uint32_t  since; // Unix time the period started, 0 if the time was not known
+  uint32_t  sinceMillis; // millis() then, 0 after a reset
+  uint32_t  uptime; // ms before the last reset that belongs to this period
+  uint32_t  boots; // Since the period started, the one it started in included
+  uint32_t  resets[2];
+  uint32_t  sessions;
+  uint32_t  onTime; // ms the modem was on
+  uint32_t  publishTime; // ms of it spent publishing
+  uint32_t  syncTime; // ms of it waiting on a time sync
+  uint32_t  publishes;
+  uint32_t  failedPublishes;
+  uint32_t  publishBytes;
+  uint64_t  busy[max_tasks]; // us
+  ConnectionStats linkAtStart;
+};
+
+#endif
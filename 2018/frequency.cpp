@@ -0,0 +1,139 @@
+/*
+
+  Stanford Engineers for a Sustainable World
+  Remote Monitoring System | August 2018
+
+  File: frequency.cpp
+  --------------------------
+  Implementation of frequency.h
+
+*/
+#include <cmath>
+#include "frequency.h"
+
+FrequencyTracker::FrequencyTracker() {
+    begin(0, false);
+}
+
+void FrequencyTracker::begin(int level, bool rectified) {
+    this->level = level;
+    this->rectified = rectified;
+    armed = false;
+    previous = 0;
+    n = 0;
+    crossings = 0;
+    firstCrossing = 0;
+    lastCycleEnd = 0;
+    cycles = 0;
+    totalCycles = 0;
+    interval = 0;
+    minFrequency = 0;
+    maxFrequency = 0;
+    meanFrequency = 0;
+    rocof = 0;
+    rocofError = -1;
+}
+
+// Crossed between the previous reading (sample n - 1) and x (sample n)
+void FrequencyTracker::addCrossing(sample_t x) {
+    if(n == 0) {
+        return;
+    }
+    double t = (double)(n - 1) + (double)(level - (int)previous) / (double)((int)x - (int)previous);
+    if(crossings == 0) {
+        firstCrossing = t;
+        lastCycleEnd = t;
+    }
+    crossings++;
+    // A cycle is every crossing of a plain wave, every other one of a rectified wave
+    if(crossings > 1 && (!rectified || crossings % 2 == 1)) {
+        totalCycles++;
+        if(cycles < max_cycles) {
+            cycleStart[cycles] = lastCycleEnd - firstCrossing;
+            cycleLength[cycles] = t - lastCycleEnd;
+            cycles++;
+        }
+        lastCycleEnd = t;
+    }
+}
+
+void FrequencyTracker::finish(double interval) {
+    this->interval = interval;
+    if(cycles == 0 || interval <= 0) {
+        cycles = 0;
+        return;
+    }
+
+    double sumT = 0, sumF = 0, sumTT = 0, sumTF = 0;
+    for(unsigned int i = 0; i < cycles; i++) {
+        double t = (cycleStart[i] + cycleLength[i] / 2) * interval / 1000000.; // Cycle midpoint, s
+        double f = getCycleFrequency(i);
+        if(i == 0 || f < minFrequency) {
+            minFrequency = f;
+        }
+        if(i == 0 || f > maxFrequency) {
+            maxFrequency = f;
+        }
+        sumT += t;
+        sumF += f;
+        sumTT += t*t;
+        sumTF += t*f;
+    }
+    double span = lastCycleEnd - firstCrossing;
+    meanFrequency = span > 0 ? 1000000. * totalCycles / (span * interval) : 0;
+    double spread = cycles * sumTT - sumT * sumT;
+    rocof = cycles > 1 && spread > 0 ? (cycles * sumTF - sumT * sumF) / spread : 0;
+
+    // Two points always fit a line, the scatter about it needs a third
+    rocofError = -1;
+    if(cycles > 2 && spread > 0) {
+        double intercept = (sumF - rocof * sumT) / cycles;
+        double squares = 0;
+        for(unsigned int i = 0; i < cycles; i++) {
+            double t = (cycleStart[i] + cycleLength[i] / 2) * interval / 1000000.;
+            double residual = getCycleFrequency(i) - intercept - rocof * t;
+            squares += residual * residual;
+        }
+        rocofError = sqrt(squares / (cycles - 2) * cycles / spread);
+    }
+}
+
+double FrequencyTracker::getSamplesPerCycle() {
+    return totalCycles > 0 ? (lastCycleEnd - firstCrossing) / totalCycles : 0;
+}
+
+bool FrequencyTracker::isValid() {
+    return cycles > 0;
+}
+
+unsigned int FrequencyTracker::getCycleCount() {
+    return cycles;
+}
+
+double FrequencyTracker::getCycleFrequency(unsigned int cycle) {
+    return cycle < cycles && cycleLength[cycle] > 0 ? 1000000. / (cycleLength[cycle] * interval) : 0;
+}
+
+double FrequencyTracker::getMinFrequency() {
+    return minFrequency;
+}
+
+double FrequencyTracker::getMaxFrequency() {
+    return maxFrequency;
+}
+
+double FrequencyTracker::getMeanFrequency() {
+    return meanFrequency;
+}
+
+double FrequencyTracker::getROCOF() {
+    return rocof;
+}
+
+double FrequencyTracker::getROCOFError() {
+    return rocofError;
+}
+
+bool FrequencyTracker::isROCOFValid() {
+    return rocofError >= 0 && rocofError < rocof_resolution;
+}
@@ -0,0 +1,87 @@
+/*
+
+  Stanford Engineers for a Sustainable World
+  Remote Monitoring System | August 2018
+
+  File: frequency.h
+  --------------------------
+  Streaming frequency tracker for the voltage input. Rising crossings of a level are timed to a fraction
+  of a sample by interpolating between the readings either side, and every cycle between crossings
+  becomes one frequency reading. A crossing only counts once the wave has dropped hysteresis counts
+  below the level, so noise around it is ignored.
+
+  A plain wave is crossed at its offset once a cycle. A rectified wave never reaches its offset, so it
+  is crossed on the way out of each trough instead, twice a cycle.
+
+*/
+
+#ifndef FREQUENCY_H
+#define FREQUENCY_H
+
+#include "sample.h"
+
+class FrequencyTracker {
+public:
+/**********************************  SETUP  ***********************************/
+  FrequencyTracker();
+
+/********************************  FUNCTIONS  *********************************/
+  void    begin(int level, bool rectified);
+  void    add(sample_t x) {
+    if(armed) {
+      if(x >= level) {
+        addCrossing(x);
+        armed = false;
+      }
+    } else if(x < level - hysteresis) {
+      armed = true;
+    }
+    previous = x;
+    n++;
+  }
+  void    finish(double interval); // Sample spacing in us, call once the capture is over
+  unsigned int  getCyclesSoFar() { return totalCycles; } // Whole cycles seen, usable while capturing
+  double  getSamplesPerCycle(); // Mean length of the cycles seen so far, 0 before the first
+  bool    isValid();
+  unsigned int  getCycleCount();
+  double  getCycleFrequency(unsigned int cycle); // Hz
+  double  getMinFrequency();
+  double  getMaxFrequency();
+  double  getMeanFrequency(); // Whole cycles over the time they took
+  double  getROCOF(); // Hz/s, slope of a least-squares line through the cycle frequencies
+  double  getROCOFError(); // Hz/s, standard error of that slope from the scatter of the cycles about the line
+  bool    isROCOFValid(); // The error is under rocof_resolution, a short or noisy window can not tell the slope from 0
+
+  static const unsigned int max_cycles = 128;
+  static constexpr double rocof_resolution = .1; // Hz/s
+
+private:
+/*********************************  HELPERS  **********************************/
+  void    addCrossing(sample_t x);
+
+/*********************************  OBJECTS  **********************************/
+  static const int hysteresis = 32; // ADC counts
+
+  int level;
+  bool rectified;
+  bool armed;
+  sample_t previous;
+  unsigned long n;
+
+  unsigned int crossings;
+  double firstCrossing; // Samples
+  double lastCycleEnd;
+  unsigned int cycles; // Stored, at most max_cycles
+  unsigned int totalCycles;
+  float cycleStart[max_cycles]; // Samples from the first crossing
+  float cycleLength[max_cycles]; // Samples
+  double interval; // us
+
+  double minFrequency;
+  double maxFrequency;
+  double meanFrequency;
+  double rocof;
+  double rocofError;
+};
+
+#endif
@@ -0,0 +1,148 @@
+/*
+
+  Stanford Engineers for a Sustainable World
+  Remote Monitoring System | August 2018
+
+  File: generator_monitor.cpp
+  --------------------------
+  Implementation of generator_monitor.h
+
+*/
+#include "generator_monitor.h"
+
+#ifdef PLATFORM_ID
+GeneratorMonitor::GeneratorMonitor() : timer(sample_interval, &GeneratorMonitor::sample, *this) {
+#else
+GeneratorMonitor::GeneratorMonitor() {
+    nextSample = 0;
+#endif
+    pin = A0;
+    level = 0;
+    running = false;
+    windowMax = 0;
+    windowCount = 0;
+    contrary = 0;
+    known = false;
+    on = false;
+    changed = false;
+    changedAt = 0;
+}
+
+void GeneratorMonitor::begin(int pin, int level) {
+    this->pin = pin;
+    this->level = level;
+    windowMax = 0;
+    windowCount = 0;
+    contrary = 0;
+    known = false;
+    changed = false;
+    resume();
+}
+
+void GeneratorMonitor::pause() {
+    running = false;
+    #ifdef PLATFORM_ID
+        timer.stop();
+    #endif
+}
+
+// The window in progress is dropped, it may have a gap in it. A Timer callback from before pause()
+// may still be running, it takes its sample under the same lock
+void GeneratorMonitor::resume() {
+    ATOMIC_BLOCK() {
+        windowMax = 0;
+        windowCount = 0;
+        running = true;
+    }
+    #ifdef PLATFORM_ID
+        timer.start();
+    #else
+        nextSample = HostHal::micros();
+    #endif
+}
+
+bool GeneratorMonitor::isRunning() {
+    return running;
+}
+
+void GeneratorMonitor::poll() {
+    #ifndef PLATFORM_ID
+        while(running && nextSample <= HostHal::micros()) {
+            addSample(HostHal::sampleAt(pin, nextSample), nextSample / 1000); // Clamped and noisy like analogRead
+            nextSample += sample_interval * 1000;
+        }
+    #endif
+}
+
+// On the Timer thread, takeChange() and resume() run on the application thread
+void GeneratorMonitor::sample() {
+    int x = analogRead(pin);
+    ATOMIC_BLOCK() {
+        if(running) {
+            addSample(x, millis());
+        }
+    }
+}
+
+void GeneratorMonitor::addSample(int x, unsigned long now) {
+    if(x > windowMax || windowCount == 0) {
+        windowMax = x;
+    }
+    if(++windowCount < window_samples) {
+        return;
+    }
+    windowCount = 0;
+
+    bool high;
+    if(windowMax > level + hysteresis) {
+        high = true;
+    } else if(windowMax < level - hysteresis) {
+        high = false;
+    } else {
+        contrary = 0; // Inside the hysteresis band, proves nothing either way
+        return;
+    }
+
+    if(!known) {
+        // on holds the candidate state until enough windows agree on it
+        if(high != on) {
+            on = high;
+            contrary = 0;
+        }
+    } else if(high == on) {
+        contrary = 0;
+        return;
+    }
+    if(++contrary >= debounce_windows) {
+        on = high;
+        known = true;
+        contrary = 0;
+        changedAt = now;
+        changed = true;
+    }
+}
+
+bool GeneratorMonitor::isKnown() {
+    return known;
+}
+
+bool GeneratorMonitor::isOn() {
+    return on;
+}
+
+bool GeneratorMonitor::hasChange() {
+    return changed;
+}
+
+// A change the Timer records between the read and the clear would be lost without the lock
+bool GeneratorMonitor::takeChange(unsigned long &when) {
+    bool taken = false;
+    ATOMIC_BLOCK() {
+        if(changed) {
+            when = changedAt;
+            changed = false;
+            taken = true;
+        }
+    }
+    return taken;
+}
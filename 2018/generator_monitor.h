@@ -0,0 +1,72 @@
+/*
+
+  Stanford Engineers for a Sustainable World
+  Remote Monitoring System | August 2018
+
+  File: generator_monitor.h
+  --------------------------
+  Watches the voltage input in the background so a generator starting or tripping is noticed within
+  a few cycles instead of at the next status check. The input is sampled every sample_interval ms
+  and the peak of each window, longer than the slowest cycle, is its envelope. The envelope has to
+  clear the status level by hysteresis counts to count as on or off, and debounce_windows windows in
+  a row have to agree before the state changes. The time of a change is kept for the status strings.
+
+  On the Electron a software Timer does the sampling, paused by Sensors while it reads the ADC itself
+  (Sensors::shareADC()). Its thread and the application's share the window and the change under
+  ATOMIC_BLOCK(). The host build has no timers, so poll() catches up on the samples that would
+  have been taken up to the current virtual time.
+
+*/
+
+#ifndef GENERATOR_MONITOR_H
+#define GENERATOR_MONITOR_H
+
+#include "application.h"
+
+class GeneratorMonitor {
+public:
+/**********************************  SETUP  ***********************************/
+  GeneratorMonitor();
+
+/********************************  FUNCTIONS  *********************************/
+  void    begin(int pin, int level); // level: ADC counts the voltage exceeds while the generator is on
+  void    pause(); // Stops sampling, e.g. while a capture needs the ADC to itself
+  void    resume();
+  bool    isRunning(); // Between begin() or resume() and pause()
+  void    poll(); // Host only, takes the samples that are due
+  void    addSample(int x, unsigned long now); // One envelope sample at millis() now
+  bool    isKnown(); // False until the first windows agree
+  bool    isOn();
+  bool    hasChange();
+  bool    takeChange(unsigned long &when); // True once per change, when is its millis()
+
+  static const unsigned long sample_interval = 2; // ms
+  static const unsigned int window_samples = 13; // 26 ms, a 40 Hz cycle is 25
+  static const unsigned int debounce_windows = 3;
+  static const int hysteresis = 32; // ADC counts
+
+private:
+/*********************************  HELPERS  **********************************/
+  void    sample();
+
+/*********************************  OBJECTS  **********************************/
+  int pin;
+  int level;
+  bool running;
+
+  int windowMax;
+  unsigned int windowCount;
+  unsigned int contrary; // Windows in a row that disagree with the state
+  volatile bool known;
+  volatile bool on;
+  volatile bool changed;
+  volatile unsigned long changedAt;
+
+  #ifdef PLATFORM_ID
+    Timer timer;
+  #else
+    uint64_t nextSample; // us
+  #endif
+};
+
+#endif
@@ -0,0 +1,231 @@
+/*
+
+  Stanford Engineers for a Sustainable World
+  Remote Monitoring System | August 2018
+
+  File: host/application.h
+  --------------------------
+  Stand-in for the Particle application.h so the firmware sources compile and run on Linux.
+  Only the parts of the Wiring API the firmware uses are provided. Pins, time and the ADC
+  are backed by the simulated board in host_hal.h.
+
+*/
+
+#ifndef HOST_APPLICATION_H
+#define HOST_APPLICATION_H
+
+#include <stdint.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <string>
+
+#include "host_hal.h"
+
+/*********************************  PINS  *************************************/
+
+enum PinMode { INPUT, OUTPUT, INPUT_PULLUP, INPUT_PULLDOWN };
+
+static const int A0 = 10;
+static const int A1 = 11;
+static const int A2 = 12;
+static const int A3 = 13;
+static const int A4 = 14;
+static const int A5 = 15;
+
+inline void pinMode(int pin, PinMode mode) { (void)pin; (void)mode; }
+inline int32_t analogRead(int pin) { return HostHal::analogRead(pin); }
+
+/*********************************  TIME  *************************************/
+
+inline unsigned long micros() { return HostHal::micros(); }
+inline unsigned long millis() { return HostHal::micros() / 1000; }
+inline void delay(unsigned long ms) { HostHal::advance((uint64_t)ms * 1000); }
+inline void delayMicroseconds(unsigned int us) { HostHal::advance(us); }
+
+// A board's firmware runs on one thread here, there is nothing for the block to be atomic against
+#define ATOMIC_BLOCK() for(bool atomic_once = true; atomic_once; atomic_once = false)
+
+/*********************************  STRING  ***********************************/
+
+class String {
+public:
+  String() {}
+  String(const char *s) : str(s ? s : "") {}
+  String(const std::string &s) : str(s) {}
+  String(int value) : str(std::to_string(value)) {}
+  String(unsigned int value) : str(std::to_string(value)) {}
+  String(long value) : str(std::to_string(value)) {}
+  String(unsigned long value) : str(std::to_string(value)) {}
+
+  static String format(const char *fmt, ...) __attribute__((format(printf, 1, 2))) {
+    char buf[512];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    return String(buf);
+  }
+
+  const char *c_str() const { return str.c_str(); }
+  unsigned int length() const { return str.length(); }
+  long toInt() const { return atol(str.c_str()); }
+  void toCharArray(char *buf, unsigned int size) const {
+    if(size == 0) return;
+    strncpy(buf, str.c_str(), size - 1);
+    buf[size - 1] = 0;
+  }
+
+  String &operator+=(const String &rhs) { str += rhs.str; return *this; }
+  String &operator+=(const char *rhs) { str += rhs; return *this; }
+  friend String operator+(const String &lhs, const String &rhs) { return String(lhs.str + rhs.str); }
+  friend String operator+(const char *lhs, const String &rhs) { return String(lhs + rhs.str); }
+  friend String operator+(const String &lhs, const char *rhs) { return String(lhs.str + rhs); }
+  bool operator==(const String &rhs) const { return str == rhs.str; }
+  bool operator!=(const String &rhs) const { return str != rhs.str; }
+
+private:
+  std::string str;
+};
+
+/*********************************  SERIAL  ***********************************/
+
+class HostSerial {
+public:
+  void begin(long baud) { (void)baud; }
+  void print(const String &s) { if(HostHal::serialEnabled()) fputs(s.c_str(), stdout); }
+  void print(const char *s) { if(HostHal::serialEnabled()) fputs(s, stdout); }
+  void println(const String &s) { if(HostHal::serialEnabled()) puts(s.c_str()); }
+  void println(const char *s) { if(HostHal::serialEnabled()) puts(s); }
+  void println() { if(HostHal::serialEnabled()) puts(""); }
+  size_t write(const uint8_t *buf, size_t len) { return HostHal::serialEnabled() ? fwrite(buf, 1, len, stdout) : len; }
+  void printlnf(const char *fmt, ...) __attribute__((format(printf, 2, 3))) {
+    if(!HostHal::serialEnabled()) return;
+    va_list args;
+    va_start(args, fmt);
+    vprintf(fmt, args);
+    va_end(args);
+    puts("");
+  }
+};
+
+extern HostSerial Serial;
+
+/*********************************  EEPROM  ***********************************/
+
+// Reads and writes the EEPROM of the selected board (host_hal.h), erased bytes read 0xFF
+class HostEEPROM {
+public:
+  static const int size = HostBoard::eeprom_size;
+
+  template <typename T> T &get(int address, T &value) {
+    if(address >= 0 && address + (int)sizeof(T) <= size) memcpy(&value, data() + address, sizeof(T));
+    return value;
+  }
+  template <typename T> const T &put(int address, const T &value) {
+    if(address >= 0 && address + (int)sizeof(T) <= size) memcpy(data() + address, &value, sizeof(T));
+    return value;
+  }
+  uint8_t read(int address) { return address >= 0 && address < size ? data()[address] : 0xFF; }
+  void write(int address, uint8_t value) { if(address >= 0 && address < size) data()[address] = value; }
+  uint16_t length() { return size; }
+  void clear() { memset(data(), 0xFF, size); }
+
+private:
+  uint8_t *data() { return HostHal::board().eeprom; }
+};
+
+extern HostEEPROM EEPROM;
+
+/*********************************  CLOUD  ************************************/
+
+// Modem, cloud, clock and reset of the selected board, see HostNetwork in host_hal.h
+
+class HostCellular {
+public:
+  void on() { HostHal::cellularOn(true); }
+  void off() { HostHal::cellularOn(false); }
+  void connect() { HostHal::cellularConnect(); }
+  void disconnect() { HostHal::cloudDisconnect(); }
+  bool ready() { return HostHal::cellularReady(); }
+};
+
+extern HostCellular Cellular;
+
+class HostParticle {
+public:
+  void connect() { HostHal::cloudConnect(); }
+  void disconnect() { HostHal::cloudDisconnect(); }
+  bool connected() { return HostHal::cloudConnected(); }
+  bool publish(const char *name, const char *data, int ttl) { (void)ttl; return HostHal::publish(name, data); }
+  void syncTime() { HostHal::syncTime(); }
+  bool syncTimePending() { return HostHal::syncTimePending(); }
+};
+
+extern HostParticle Particle;
+
+class HostTime {
+public:
+  time_t now() { return HostHal::now(); }
+  bool isValid() { return HostHal::timeValid(); }
+  String format(const char *fmt) { return format(now(), fmt); }
+  String format(time_t t, const char *fmt) {
+    char buf[64];
+    struct tm parts;
+    gmtime_r(&t, &parts);
+    strftime(buf, sizeof(buf), fmt, &parts);
+    return String(buf);
+  }
+  int day(time_t t) { return field(t).tm_mday; }
+  int month(time_t t) { return field(t).tm_mon + 1; }
+  int year(time_t t) { return field(t).tm_year + 1900; }
+  int hour(time_t t) { return field(t).tm_hour; }
+  int minute(time_t t) { return field(t).tm_min; }
+
+private:
+  struct tm field(time_t t) {
+    struct tm parts;
+    gmtime_r(&t, &parts);
+    return parts;
+  }
+};
+
+extern HostTime Time;
+
+class HostSystem {
+public:
+  void reset() { throw HostHal::Reset(); }
+};
+
+extern HostSystem System;
+
+inline int cellular_credentials_set(const char *apn, const char *username, const char *password, void *reserved) {
+  (void)apn; (void)username; (void)password; (void)reserved;
+  return 0;
+}
+
+// Host timers never fire. The firmware's only use, connectTimer, fires if Cellular.connect() blocks for
+// minutes, which the simulated one never does.
+class Timer {
+public:
+  template <typename T> Timer(unsigned int period, void (T::*handler)(), T &instance, bool oneShot = false) {
+    (void)period; (void)handler; (void)instance; (void)oneShot;
+  }
+  void start() {}
+  void stop() {}
+  void reset() {}
+};
+
+/*********************************  LED  **************************************/
+
+class LEDStatus {
+public:
+  void setActive(bool active = true) { (void)active; }
+  void on() {}
+  void off() {}
+};
+
+#endif
@@ -0,0 +1,404 @@
+/*
+
+  Stanford Engineers for a Sustainable World
+  Remote Monitoring System | August 2018
+
+  File: host/bench.cpp
+  --------------------------
+  Times each stage of the Sensors pipeline on the host and checks the results against the
+  waves the simulated board was fed.
+
+  Usage: bench [iterations] [recording.csv]
+         bench --sweep <captures> [results]   prints the results of that many random captures, given
+                                              the double build's results compares them instead
+
+*/
+#include "application.h"
+#include "sensors.h"
+#include "generator_monitor.h"
+#include <chrono>
+#include <random>
+#include <vector>
+
+struct Scenario {
+  const char *name;
+  HostWave waves[4];
+  bool resolvesROCOF; // Clean enough that the crossings have to resolve the ROCOF, others may say they can not
+};
+
+class SensorsBenchmark {
+public:
+  enum Stage { RECORD, SMOOTH, SPECTRUM, FREQUENCY, AMPLITUDE, POWER, stage_count };
+
+  SensorsBenchmark(Sensors &sensors) : sensors(sensors) {
+    for(int i = 0; i < stage_count; i++) {
+      total[i] = 0;
+      worst[i] = 0;
+    }
+    runs = 0;
+  }
+
+  // Runs the same steps as refreshAll(), timing each stage. The bench is built for SITE_BENCH, every channel enabled.
+  void run() {
+    sensors.init();
+    HostHal::advance(0);
+    time(RECORD, [&]{ sensors.recordSamples(); });
+    time(SMOOTH, [&]{ sensors.analyzeSmoothedWaves(); });
+    time(SPECTRUM, [&]{ sensors.analyzeSpectrum(); });
+    time(FREQUENCY, [&]{ sensors.bruteforceFrequencies(); });
+    time(AMPLITUDE, [&]{ sensors.bruteforceAmplitudes(); });
+    time(POWER, [&]{ sensors.calculatePower(); });
+    runs++;
+  }
+
+  void printTimes(const char *name) {
+    static const char *names[stage_count] = {"recordSamples", "analyzeSmoothedWaves", "analyzeSpectrum", "bruteforceFrequencies", "bruteforceAmplitudes", "calculatePower"};
+    double sum = 0;
+    printf("%s (%d runs)\n", name, runs);
+    for(int i = 0; i < stage_count; i++) {
+      printf("  %-22s mean %9.3f ms   worst %9.3f ms\n", names[i], total[i] / runs, worst[i]);
+      sum += total[i] / runs;
+    }
+    printf("  %-22s mean %9.3f ms\n", "total", sum);
+  }
+
+  // Compares the last run against the waves the board was fed. Returns false if any fit is off.
+  bool checkAccuracy(const Scenario &scenario) {
+    bool ok = sensors.measurementsValid;
+    // A drifting wave is fit by its average frequency, and its phase at sample 0 no longer matches
+    double span = sensors.sampleCount * sensors.measurementDuration / 1e6;
+    double drift = scenario.waves[0].chirp;
+    double frequency = scenario.waves[0].frequency + drift * span / 2;
+    double periodError = (double)sensors.period - 1000000. / frequency;
+    printf("  window %u samples (%.1f ms)\n", sensors.sampleCount, span * 1e3);
+    printf("  period %u us (error %+.1f us)%s\n", sensors.period, periodError, sensors.measurementsValid ? "" : "  MEASUREMENT INVALID");
+    ok = ok && fabs(periodError) < 5;
+    double frequencyError = sensors.getMeanFrequency() - frequency;
+    printf("  crossings: %u cycles, mean %.3f Hz (error %+.3f Hz), min %.3f, max %.3f, rocof %+.3f Hz/s (expected %+.3f, standard error %.3f%s)\n",
+      sensors.getCycleCount(), sensors.getMeanFrequency(), frequencyError, sensors.getMinFrequency(), sensors.getMaxFrequency(), sensors.getROCOF(), drift,
+      sensors.tracker.getROCOFError(), sensors.isROCOFValid() ? "" : ", not resolved");
+    ok = ok && fabs(frequencyError) < .05 && (sensors.isROCOFValid() || !scenario.resolvesROCOF)
+      && (!sensors.isROCOFValid() || fabs(sensors.getROCOF() - drift) < .15);
+    for(unsigned int i = 0; i < Sensors::input_count; i++) {
+      const HostWave &w = scenario.waves[i];
+      double amplitude = sensors.input[i].amplitude / 100.;
+      double amplitudeError = (amplitude - w.amplitude) / w.amplitude;
+      // Channel i is read scanPosition(i) channel delays after the start of each scan
+      double cycle = w.rectified ? .5 : 1;
+      double expected = fmod(w.phase + w.frequency * scanPosition(i) * sensors.channelDelay / 1e6, cycle);
+      double phaseError = fmod((double)sensors.input[i].xShift / sensors.xShiftRangeMax - expected + 1.5 * cycle, cycle) - .5 * cycle;
+      printf("  %u: amplitude %8.1f (error %+6.2f%%)  phase error %+7.4f cycles  residual %8.1f  thd %6.3f\n", i, amplitude, 100 * amplitudeError, phaseError, sensors.input[i].error, sensors.getTHD(i));
+      ok = ok && fabs(amplitudeError) < .02 && (drift != 0 || fabs(phaseError) < .01);
+    }
+    // True RMS and power factor of each current against the (pure) voltage. Harmonics and noise add
+    // to the RMS but not to the real power.
+    for(unsigned int i = 1; i < Sensors::input_count; i++) {
+      const HostWave &v = scenario.waves[0];
+      const HostWave &w = scenario.waves[i];
+      double meanSquare = 1;
+      for(int h = 0; h < 8; h++) {
+        meanSquare += w.harmonics[h] * w.harmonics[h];
+      }
+      meanSquare = meanSquare * w.amplitude * w.amplitude / 2 + w.noise * w.noise / 3;
+      double expected = sqrt(meanSquare);
+      double pf = cos(2 * M_PI * (w.phase - v.phase)) * w.amplitude / sqrt(2) / expected;
+      if(v.rectified) {
+        pf = fabs(pf);
+      }
+      double rms = sensors.accumulator.getRms(i);
+      double rmsError = (rms - expected) / expected;
+      printf("  %u: true rms %8.1f (error %+6.2f%%)  power factor %6.3f (expected %6.3f)\n", i, rms, 100 * rmsError, sensors.getPowerFactor(i), pf);
+      ok = ok && fabs(rmsError) < .02 && fabs(sensors.getPowerFactor(i) - pf) < .02;
+    }
+    return ok;
+  }
+
+  // A DMA that never delivers a block has to cost one dropped capture, not the board. The capture is
+  // taken again with analogRead() and the period still has to come out right. The next capture goes
+  // back to the DMA, and only max_timeouts failures in a row leave it off until init().
+  bool checkFallback(const Scenario &scenario) {
+    HostHal::reset();
+    for(int c = 0; c < 4; c++) {
+      HostHal::setWave(A0 + c, scenario.waves[c]);
+    }
+    HostHal::board().acquisitionStalls = true;
+    sensors.init();
+    sensors.refreshAll();
+    bool failed = sensors.acquisition.failed();
+    // Analysis takes no virtual time, so the last capture ended now
+    double middle = HostHal::micros() - sensors.sampleCount * sensors.measurementDuration / 2;
+    double frequency = scenario.waves[0].frequency + scenario.waves[0].chirp * middle / 1e6;
+    double periodError = (double)sensors.period - 1000000. / frequency;
+    bool valid = sensors.measurementsValid;
+    HostHal::board().acquisitionStalls = false;
+    sensors.recordSamples();
+    bool recovered = !sensors.acquisition.failed() && !sensors.acquisition.disabled();
+    HostHal::board().acquisitionStalls = true;
+    for(unsigned int i = 0; i < Acquisition::max_timeouts; i++) {
+      sensors.recordSamples();
+    }
+    bool latched = sensors.acquisition.disabled();
+    HostHal::board().acquisitionStalls = false;
+    sensors.init();
+    bool ok = failed && valid && fabs(periodError) < 5 && recovered && latched;
+    printf("  stalled DMA: %s, period error %+.1f us, %s, %s%s\n", failed ? "fell back to analogRead()" : "did not time out",
+      periodError, recovered ? "DMA again on the next capture" : "DMA not retried",
+      latched ? "off after repeated stalls" : "never given up", ok ? "" : "  CHECK FAILED");
+    return ok;
+  }
+
+  // One cold refreshAll() of the board's waves. Appends the period, then the amplitude, phase, spectral
+  // fundamental and THD of each input.
+  void measure(std::vector<double> &results) {
+    sensors.warmStart = Sensors::WarmStart();
+    sensors.init();
+    sensors.refreshAll();
+    results.push_back(sensors.period);
+    for(unsigned int i = 0; i < Sensors::input_count; i++) {
+      results.push_back(sensors.input[i].amplitude / 100.);
+      results.push_back((double)sensors.input[i].xShift / sensors.xShiftRangeMax);
+      results.push_back(sensors.input[i].spectrum.getFundamental());
+      results.push_back(sensors.getTHD(i));
+    }
+  }
+
+  // One refreshAll() through the profiler, stages are timed in host CPU time
+  bool checkProfile() {
+    MeasurementProfiler &profiler = sensors.getProfiler();
+    profiler.clearTotals();
+    sensors.refreshAll();
+    Payload<200> summary;
+    bool ok = profiler.appendSummary(summary) && profiler.getMeasurements() == 1 && profiler.getAttempts() >= 1
+      && profiler.getStageTime(MeasurementProfiler::amplitude) > 0 && profiler.getStageFits(MeasurementProfiler::amplitude) > 0;
+    printf("  profile: %u attempts, %u period fits%s, %u amplitude fits, summary %s%s\n", profiler.getAttempts(),
+      (unsigned int)profiler.getStageFits(MeasurementProfiler::frequency), profiler.wasWarm() ? " (warm)" : "",
+      (unsigned int)profiler.getStageFits(MeasurementProfiler::amplitude), summary.c_str(), ok ? "" : "  CHECK FAILED");
+    return ok;
+  }
+
+private:
+  template <typename F> void time(Stage stage, F f) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    f();
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    total[stage] += ms;
+    if(ms > worst[stage]) {
+      worst[stage] = ms;
+    }
+  }
+
+  Sensors &sensors;
+  double total[stage_count];
+  double worst[stage_count];
+  int runs;
+};
+
+static HostWave wave(double yShift, double amplitude, double frequency, double phase, bool rectified, double noise) {
+  HostWave w;
+  w.yShift = yShift;
+  w.amplitude = amplitude;
+  w.frequency = frequency;
+  w.phase = phase;
+  w.rectified = rectified;
+  w.noise = noise;
+  return w;
+}
+
+// Trips the generator for two seconds and checks the monitor reports both edges within a few cycles,
+// and that the status check sees the trip too. Both read the clamped, noisy ADC, where a stopped
+// generator reads near 0 and not yShift.
+static bool checkGeneratorMonitor(Sensors &sensors, const Scenario &scenario) {
+  const double start = 1e6, end = 3e6, limit = 100; // us, us, ms
+  HostWave w = scenario.waves[0];
+  w.outageStart = start;
+  w.outageEnd = end;
+  HostHal::reset();
+  HostHal::setWave(A0, w);
+  sensors.init();
+  GeneratorMonitor monitor;
+  monitor.begin(site_channels[0].pin, sensors.getStatusLevel());
+  double off = -1, on = -1;
+  unsigned long when;
+  while(HostHal::micros() < 4e6) {
+    HostHal::advance(10000);
+    monitor.poll();
+    if(monitor.takeChange(when) && monitor.isKnown()) {
+      if(!monitor.isOn() && off < 0) off = when - start / 1000;
+      if(monitor.isOn() && when > end / 1000 && on < 0) on = when - end / 1000;
+    }
+  }
+  HostHal::reset();
+  HostHal::setWave(A0, w);
+  HostHal::advance((uint64_t)(start + end) / 2);
+  sensors.refreshStatus();
+  bool statusOff = !sensors.generatorIsOn();
+  HostHal::advance((uint64_t)end);
+  sensors.refreshStatus();
+  bool statusOn = sensors.generatorIsOn();
+  bool ok = off >= 0 && off < limit && on >= 0 && on < limit && statusOff && statusOn;
+  printf("  generator monitor: off after %.0f ms, on after %.0f ms, status check %s%s\n", off, on,
+    statusOff && statusOn ? "sees the trip" : "misses the trip", ok ? "" : "  CHECK FAILED");
+  return ok;
+}
+
+// A polled capture of the voltage alone puts samples far closer than the timed 365 us. The spectrum
+// has to come out right there too, the fixed-point bank's states grow as the tones near 0 cycles per sample.
+static bool checkSpectrumSpacing() {
+  const unsigned int count = 4000;
+  const double interval = 20, frequency = 50, amplitude = 2000; // us, Hz, ADC counts
+  static sample_t samples[count];
+  for(unsigned int i = 0; i < count; i++) {
+    samples[i] = SampleTraits<sample_t>::fromDouble(2048 + amplitude * sin(2 * M_PI * frequency * i * interval / 1e6));
+  }
+  Spectrum spectrum;
+  bool valid = spectrum.analyze(samples, count, interval, 40, 66, false);
+  double frequencyError = spectrum.getFundamental() - frequency;
+  double amplitudeError = (spectrum.getHarmonic(1) - amplitude) / amplitude;
+  bool ok = valid && fabs(frequencyError) < .1 && fabs(amplitudeError) < .02;
+  printf("spectrum of samples %.0f us apart: fundamental error %+.3f Hz, amplitude error %+.2f%%%s\n\n", interval,
+    frequencyError, 100 * amplitudeError, ok ? "" : "  CHECK FAILED");
+  return ok;
+}
+
+// bench --sweep. Both builds generate the same random captures (40-66 Hz, noise, 3rd and 5th harmonics on
+// the currents), the fixed-point one compares its results with the double build's and fails if the worst
+// differences pass the table in fixed_point.h.
+static bool sweep(Sensors &sensors, int captures, const char *reference) {
+  enum { PERIOD, AMPLITUDE, PHASE, FUNDAMENTAL, THD, result_kinds };
+  static const char *names[result_kinds] = {"period", "amplitude", "phase", "spectral fundamental", "THD"};
+  static const double limits[result_kinds] = {1, .0001, .001, .001, .0001}; // us, ratio, cycles, Hz, ratio
+  FILE *in = nullptr;
+  if(reference && !(in = fopen(reference, "r"))) {
+    fprintf(stderr, "Could not read results %s\n", reference);
+    return false;
+  }
+  std::mt19937 random(1);
+  std::uniform_real_distribution<double> uniform(0, 1);
+  SensorsBenchmark bench(sensors);
+  double worst[result_kinds] = {};
+  bool complete = true;
+  for(int n = 0; n < captures && complete; n++) {
+    double frequency = 40 + 26 * uniform(random);
+    HostHal::reset();
+    for(int c = 0; c < 4; c++) {
+      HostWave w = c == 0 ? wave(-321, 1200 + 200 * uniform(random), frequency, uniform(random), true, 20 * uniform(random))
+        : wave(1975, 100 + 1700 * uniform(random), frequency, uniform(random), false, 20 * uniform(random));
+      if(c > 0) {
+        w.harmonics[1] = .1 * uniform(random); // 3rd
+        w.harmonics[3] = .05 * uniform(random); // 5th
+      }
+      HostHal::setWave(A0 + c, w);
+    }
+    std::vector<double> results;
+    bench.measure(results);
+    for(size_t i = 0; i < results.size(); i++) {
+      if(!in) {
+        printf(i + 1 < results.size() ? "%.6f " : "%.6f\n", results[i]);
+        continue;
+      }
+      double expected;
+      if(fscanf(in, "%lf", &expected) != 1) {
+        complete = false;
+        break;
+      }
+      int kind = i == 0 ? PERIOD : 1 + (i - 1) % 4;
+      double difference = fabs(results[i] - expected);
+      if(kind == AMPLITUDE) {
+        difference /= fmax(expected, 1);
+      } else if(kind == PHASE) {
+        double cycle = site_channels[(i - 1) / 4].rectified ? .5 : 1;
+        difference = fmod(difference, cycle);
+        difference = fmin(difference, cycle - difference);
+      }
+      worst[kind] = fmax(worst[kind], difference);
+    }
+  }
+  if(!in) {
+    return true;
+  }
+  fclose(in);
+  bool ok = complete;
+  printf("%d captures, worst fixed-point differences from the double build%s\n", captures, complete ? "" : " (RESULTS END EARLY)");
+  for(int k = 0; k < result_kinds; k++) {
+    bool within = worst[k] <= limits[k] + 1e-9; // A period step is exactly the limit
+    printf("  %-22s %.6f (limit %.6f)%s\n", names[k], worst[k], limits[k], within ? "" : "  CHECK FAILED");
+    ok = ok && within;
+  }
+  return ok;
+}
+
+static std::vector<Scenario> scenarios() {
+  std::vector<Scenario> list;
+  // yShift and rectification match SITE_BENCH in site_config.h
+  Scenario clean = {"clean 50 Hz", {wave(-321, 1300, 50, .1, true, 0), wave(1975, 600, 50, .3, false, 0), wave(1975, 600, 50, .63, false, 0), wave(1975, 600, 50, .97, false, 0)}, true};
+  Scenario noisy = {"noisy 47.3 Hz, light load", {wave(-321, 1250, 47.3, .2, true, 20), wave(1975, 150, 47.3, .35, false, 15), wave(1975, 120, 47.3, .7, false, 15), wave(1975, 90, 47.3, .02, false, 15)}};
+  Scenario distorted = {"distorted 61.7 Hz", {wave(-321, 1350, 61.7, .45, true, 10), wave(1975, 900, 61.7, .5, false, 10), wave(1975, 850, 61.7, .83, false, 10), wave(1975, 800, 61.7, .16, false, 10)}};
+  for(int i = 1; i < 4; i++) {
+    distorted.waves[i].harmonics[1] = .08; // 3rd
+    distorted.waves[i].harmonics[3] = .04; // 5th
+  }
+  Scenario edges = {"band edges 40.5 Hz", {wave(-321, 1300, 40.5, .9, true, 10), wave(1975, 1500, 40.5, .1, false, 10), wave(1975, 40, 40.5, .4, false, 10), wave(1975, 1900, 40.5, .75, false, 10)}};
+  Scenario sagging = {"52 Hz sagging under load", {wave(-321, 1300, 52, .3, true, 10), wave(1975, 700, 52, .35, false, 10), wave(1975, 700, 52, .68, false, 10), wave(1975, 700, 52, .02, false, 10)}};
+  Scenario collapsing = {"56 Hz collapsing, clean", {wave(-321, 1300, 56, .6, true, 2), wave(1975, 1100, 56, .25, false, 5), wave(1975, 1000, 56, .58, false, 5), wave(1975, 1200, 56, .91, false, 5)}, true};
+  for(int i = 0; i < 4; i++) {
+    sagging.waves[i].chirp = -.5;
+    collapsing.waves[i].chirp = -2;
+  }
+  list.push_back(clean);
+  list.push_back(noisy);
+  list.push_back(distorted);
+  list.push_back(edges);
+  list.push_back(sagging);
+  list.push_back(collapsing);
+  return list;
+}
+
+int main(int argc, char **argv) {
+  int iterations = argc > 1 ? atoi(argv[1]) : 20;
+  static Sensors sensors; // Too big for the stack, same as on the Electron
+  bool ok = true;
+
+  if(argc > 2 && strcmp(argv[1], "--sweep") == 0) {
+    return sweep(sensors, atoi(argv[2]), argc > 3 ? argv[3] : nullptr) ? 0 : 1;
+  }
+  if(argc > 2) {
+    HostHal::reset();
+    if(!HostHal::loadRecording(argv[2])) {
+      fprintf(stderr, "Could not read recording %s\n", argv[2]);
+      return 1;
+    }
+    SensorsBenchmark bench(sensors);
+    for(int i = 0; i < iterations; i++) {
+      bench.run();
+    }
+    bench.printTimes(argv[2]);
+    return 0;
+  }
+
+  ok = checkSpectrumSpacing() && ok;
+  std::vector<Scenario> list = scenarios();
+  for(size_t s = 0; s < list.size(); s++) {
+    HostHal::reset();
+    for(int i = 0; i < 4; i++) {
+      HostHal::setWave(A0 + i, list[s].waves[i]);
+    }
+    SensorsBenchmark bench(sensors);
+    for(int i = 0; i < iterations; i++) {
+      HostHal::reset();
+      for(int c = 0; c < 4; c++) {
+        HostHal::setWave(A0 + c, list[s].waves[c]);
+      }
+      bench.run();
+    }
+    bench.printTimes(list[s].name);
+    if(!bench.checkAccuracy(list[s])) {
+      printf("  ACCURACY CHECK FAILED\n");
+      ok = false;
+    }
+    ok = bench.checkProfile() && ok;
+    ok = bench.checkFallback(list[s]) && ok;
+    ok = checkGeneratorMonitor(sensors, list[s]) && ok;
+    printf("\n");
+  }
+  return ok ? 0 : 1;
+}
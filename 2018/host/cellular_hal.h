@@ -0,0 +1,17 @@
+/*
+
+  Stanford Engineers for a Sustainable World
+  Remote Monitoring System | August 2018
+
+  File: host/cellular_hal.h
+  --------------------------
+  Stand-in for the Particle header, cellular_credentials_set() is in the host application.h
+
+*/
+
+#ifndef HOST_CELLULAR_HAL_H
+#define HOST_CELLULAR_HAL_H
+
+#include "application.h"
+
+#endif
@@ -0,0 +1,49 @@
+/*
+
+  Stanford Engineers for a Sustainable World
+  Remote Monitoring System | August 2018
+
+  File: host/decode.cpp
+  --------------------------
+  Decodes DATA publishes in the wire_format.h encoding to CSV, one line per record. Values are the
+  compressed ones the board stores, i.e. 100x the measurement.
+
+  Usage: decode [batch ...]    batches are read one per line from stdin if none are given
+
+*/
+#include "wire_format.h"
+#include <stdio.h>
+#include <string.h>
+
+static bool printBatch(const char *text) {
+  WireBatch batch;
+  if(!decodeWireBatch(text, batch)) {
+    fprintf(stderr, "Not a valid batch: %s\n", text);
+    return false;
+  }
+  printf("# version %u, %u records left, time %u\n", batch.version, batch.remaining, batch.time);
+  for(unsigned int i = 0; i < batch.count; i++) {
+    const LogRecord &r = batch.records[i];
+    printf("%u,%u,%u,%u,%u,%u,%u\n", r.sequence, r.current_1, r.current_2, r.current_3, r.frequency, r.voltage, r.power);
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  bool ok = true;
+  printf("sequence,current_1,current_2,current_3,frequency,voltage,power\n");
+  if(argc > 1) {
+    for(int i = 1; i < argc; i++) {
+      ok = printBatch(argv[i]) && ok;
+    }
+    return ok ? 0 : 1;
+  }
+  char line[1024];
+  while(fgets(line, sizeof(line), stdin)) {
+    line[strcspn(line, "\r\n")] = 0;
+    if(line[0]) {
+      ok = printBatch(line) && ok;
+    }
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,362 @@
+/*
+
+  Stanford Engineers for a Sustainable World
+  Remote Monitoring System | August 2018
+
+  File: host/fleet.cpp
+  --------------------------
+  Runs a fleet of simulated boards, each the real Transmitter (store, publish, status and session
+  logic) and Sensors analysis on its own HostBoard, on a pool of threads in virtual time. Every
+  board gets its own generator, nightly outage, load and network, seeded by its device number, and
+  publishes to one local endpoint that decodes what arrives. The report is what a fleet would look
+  like to the cloud: ingest per hour, the backlog boards report, lost or repeated records, resets,
+  the energy the ledgers report and what the analysis costs in CPU. Every status string is checked
+  against its board's outage schedule, and the run exits 1 if one is not on it or a scheduled
+  change old enough to have been published never was.
+
+  Usage: fleet [devices] [days] [threads] [--monitor] [--serial]
+         --monitor  polls the generator monitor as loop() does without timers, many times slower
+         --serial   prints device 0's Serial output
+
+  Boards are built for SITE_BENCH, every input in use, so the analysis cost is the worst case.
+  Analysis times come from each board's PROF events, which the host profiler takes in thread CPU time.
+
+*/
+#include "application.h"
+#include "transmitter.h"
+#include <algorithm>
+#include <math.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <time.h>
+#include <vector>
+
+static const double hour = 3600e6; // us
+static const double outage_period = 24 * hour;
+static const double status_slack = 60e6; // Status strings are to the minute
+static const double status_limit = 7 * 60e6; // The 5 minute status check, the minute and the session
+static const double publish_limit = 4 * hour + status_limit; // A change this old has to have reached the cloud
+
+struct Device {
+  HostBoard board;
+  ConnectionStats linkStats; // Retained, so they outlive the Transmitter across resets
+  EnergyLedger ledger;
+  double bootOffset = 0; // us, when it was switched on after the fleet's start
+  double outageStart = 0; // us of board time, every outage_period, none if it equals outageEnd
+  double outageEnd = 0;
+  unsigned int resets = 0;
+  double cpu = 0; // s of thread CPU time
+};
+
+// The stand-in for the cloud, every board's thread publishes through it
+class FleetCloud : public HostCloud {
+public:
+  FleetCloud(const std::vector<std::unique_ptr<Device>> &devices, double days) : devices(devices),
+    expected(devices.size(), -1), backlog(devices.size(), 0), hourly((size_t)(days * 24) + 2, 0),
+    hourlyRecords(hourly.size(), 0), end(days * 24 * hour), seen(devices.size(), std::vector<int>((size_t)days + 2, 0)) {}
+
+  bool publish(int device, const char *name, const char *data, double t) {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t slot = std::min(hourly.size() - 1, (size_t)((t + devices[device]->bootOffset) / hour));
+    events++;
+    bytes += strlen(name) + strlen(data);
+    hourly[slot]++;
+    if(strcmp(name, "DATA") == 0) {
+      if(decodeWireBatch(data, batch)) {
+        takeBatch(device, slot);
+      } else {
+        takeStatus(device, data);
+      }
+    } else if(strcmp(name, "PROF") == 0) {
+      takeProfile(data);
+    } else if(strcmp(name, "LEDG") == 0) {
+      takeLedger(data);
+    }
+    return true;
+  }
+
+  // False if a status string was off the schedule or a scheduled change went missing
+  bool report(double deviceDays) {
+    size_t peak = std::max_element(hourlyRecords.begin(), hourlyRecords.end()) - hourlyRecords.begin();
+    unsigned long totalBacklog = 0;
+    unsigned int maxBacklog = 0;
+    for(size_t i = 0; i < backlog.size(); i++) {
+      totalBacklog += backlog[i];
+      maxBacklog = std::max(maxBacklog, backlog[i]);
+    }
+    printf("ingest       %lu events (%lu DATA batches, %lu status, %lu PROF, %lu LEDG), %.1f kB\n", events, batches,
+      statuses, profiles, ledgers, bytes / 1000.);
+    printf("records      %lu, %.1f per device-day, %lu missing, %lu repeated\n", records, records / deviceDays, gaps, repeats);
+    printf("per hour     mean %.0f events %.0f records, peak %lu events %lu records in hour %zu\n",
+      events / (hourly.size() - 1.), records / (hourly.size() - 1.), hourly[peak], hourlyRecords[peak], peak);
+    printf("backlog      largest reported %u records, last reported %lu in all, %u at most on one board\n", maxSeen,
+      totalBacklog, maxBacklog);
+    if(measurements > 0) {
+      printf("analysis     %lu measurements, %.2f attempts each, %.2f ms CPU each (capture simulation %.2f ms)\n",
+        measurements, (double)attempts / measurements, analysisTime / measurements / 1000, recordTime / measurements / 1000);
+    }
+    if(ledgerTime > 0) {
+      printf("energy       %.0f mAh and %.0f s of modem per device-day, by %lu ledgers\n", charge / ledgerTime * 86400,
+        modemTime / ledgerTime * 86400, ledgers);
+    }
+
+    unsigned long scheduled = 0, missed = 0;
+    for(size_t i = 0; i < devices.size(); i++) {
+      const Device &d = *devices[i];
+      if(d.outageEnd == d.outageStart) continue;
+      for(size_t k = 0; k < seen[i].size(); k++) {
+        for(int on = 0; on < 2; on++) {
+          double edge = (on ? d.outageEnd : d.outageStart) + k * outage_period;
+          if(edge <= end - publish_limit) {
+            scheduled++;
+            missed += !(seen[i][k] & (1 << on));
+          }
+        }
+      }
+    }
+    bool ok = unexpected == 0 && missed == 0;
+    printf("status       %lu changes in %lu publishes, %lu on schedule (mean %.1f, worst %.1f min after), %lu off it, %lu of %lu due missing%s\n",
+      changes, statuses, onSchedule, onSchedule ? delaySum / onSchedule / 60e6 : 0., delayMax / 60e6, unexpected, missed, scheduled,
+      ok ? "" : "  CHECK FAILED");
+    return ok;
+  }
+
+private:
+  void takeBatch(int device, size_t slot) {
+    batches++;
+    records += batch.count;
+    hourlyRecords[slot] += batch.count;
+    for(unsigned int i = 0; i < batch.count; i++) {
+      long sequence = batch.records[i].sequence;
+      if(expected[device] >= 0 && sequence > expected[device]) {
+        gaps += sequence - expected[device];
+      } else if(expected[device] >= 0 && sequence < expected[device]) {
+        repeats++;
+      }
+      expected[device] = std::max(expected[device], sequence + 1);
+    }
+    backlog[device] = batch.remaining - batch.count;
+    maxSeen = std::max(maxSeen, batch.remaining);
+  }
+
+  // "off," or "on," and %d%m%y%H%M of the change, a publish may hold both. The board's Unix time is its
+  // epoch at virtual 0, so each maps back to board time and the outage edge it should follow
+  void takeStatus(int device, const char *data) {
+    const Device &d = *devices[device];
+    statuses++;
+    const char *p = data;
+    while(*p) {
+      bool on = strncmp(p, "on,", 3) == 0;
+      if(!on && strncmp(p, "off,", 4) != 0) break;
+      p += on ? 3 : 4;
+      tm when = tm();
+      if(sscanf(p, "%2d%2d%2d%2d%2d", &when.tm_mday, &when.tm_mon, &when.tm_year, &when.tm_hour, &when.tm_min) != 5) break;
+      p += 10;
+      when.tm_mon -= 1;
+      when.tm_year += 100;
+      double at = ((double)timegm(&when) - d.board.epoch) * 1e6;
+      double edge = on ? d.outageEnd : d.outageStart;
+      long k = (long)floor((at + status_slack - edge) / outage_period);
+      double delay = at - (edge + k * outage_period);
+      changes++;
+      if(d.outageEnd != d.outageStart && k >= 0 && k < (long)seen[device].size() && delay >= -status_slack && delay <= status_limit) {
+        onSchedule++;
+        seen[device][k] |= 1 << on;
+        delaySum += std::max(delay, 0.);
+        delayMax = std::max(delayMax, delay);
+      } else {
+        unexpected++;
+      }
+    }
+  }
+
+  // P1,<measurements>,<attempts>,<warm>,<fits per stage>,<mean us per stage>,...
+  void takeProfile(const char *data) {
+    std::vector<double> f = fields(data);
+    const unsigned int stages = MeasurementProfiler::stage_count;
+    if(f.size() < 4 + 2 * stages) return;
+    profiles++;
+    measurements += f[1];
+    attempts += f[2];
+    recordTime += f[4 + stages] * f[1];
+    for(unsigned int s = 1; s < stages; s++) {
+      analysisTime += f[4 + stages + s] * f[1];
+    }
+  }
+
+  // L1,<s covered>,...,<modem on s> is field 6, <mAh> field 16
+  void takeLedger(const char *data) {
+    std::vector<double> f = fields(data);
+    if(f.size() < 17) return;
+    ledgers++;
+    ledgerTime += f[1];
+    modemTime += f[6];
+    charge += f[16];
+  }
+
+  static std::vector<double> fields(const char *data) {
+    std::vector<double> f;
+    const char *p = data + 1; // Past the letter of the version
+    while(*p) {
+      f.push_back(strtod(p, (char **)&p));
+      if(*p == ',') p++;
+      else if(*p) break;
+    }
+    return f;
+  }
+
+  std::mutex mutex;
+  const std::vector<std::unique_ptr<Device>> &devices;
+  WireBatch batch;
+  std::vector<long> expected; // Next sequence each board should send, -1 until its first
+  std::vector<unsigned int> backlog; // Records each board still had when it last published
+  std::vector<unsigned long> hourly;
+  std::vector<unsigned long> hourlyRecords;
+  unsigned long events = 0, bytes = 0, batches = 0, statuses = 0, records = 0, gaps = 0, repeats = 0;
+  unsigned int maxSeen = 0;
+  unsigned long profiles = 0, measurements = 0, attempts = 0;
+  double analysisTime = 0, recordTime = 0; // us
+  unsigned long ledgers = 0;
+  double ledgerTime = 0, modemTime = 0, charge = 0;
+  double end; // us of board time the boards run to
+  std::vector<std::vector<int>> seen; // Per board and outage, bit 0 its off was reported, bit 1 its on
+  unsigned long changes = 0, onSchedule = 0, unexpected = 0;
+  double delaySum = 0, delayMax = 0;
+};
+
+static HostWave wave(double yShift, double amplitude, double frequency, double phase, bool rectified, double noise) {
+  HostWave w;
+  w.yShift = yShift;
+  w.amplitude = amplitude;
+  w.frequency = frequency;
+  w.phase = phase;
+  w.rectified = rectified;
+  w.noise = noise;
+  return w;
+}
+
+// A board's site and network, the same for a device number every run
+static void configure(Device &device, int id, HostCloud *cloud) {
+  std::mt19937 random(id + 1);
+  std::uniform_real_distribution<double> uniform(0, 1);
+  HostBoard &board = device.board;
+  board.device = id;
+  board.cloud = cloud;
+  board.randomState = id * 2654435761u + 1;
+  board.noiseState = id * 40503u + 7;
+
+  double frequency = 48 + 4 * uniform(random);
+  double load = 100 + 1400 * uniform(random);
+  double noise = 5 + 15 * uniform(random);
+  double outageStart = (18 + 6 * uniform(random)) * hour; // Switched off in the evening
+  double outageLength = uniform(random) < .2 ? 0 : (2 + 8 * uniform(random)) * hour; // One in five run all night
+  device.bootOffset = 4 * uniform(random) * hour; // Boards were not all switched on at once
+  board.epoch += (uint32_t)(device.bootOffset / 1e6);
+
+  if(outageLength > 0) {
+    device.outageStart = outageStart - device.bootOffset;
+    device.outageEnd = device.outageStart + outageLength;
+  }
+  for(int i = 0; i < 4; i++) {
+    HostWave w = i == 0 ? wave(-321, 1250 + 100 * uniform(random), frequency, uniform(random), true, noise)
+                        : wave(1975, load * (.7 + .6 * uniform(random)), frequency, uniform(random), false, noise);
+    if(outageLength > 0) {
+      w.outageStart = device.outageStart;
+      w.outageEnd = device.outageEnd;
+      w.outagePeriod = outage_period;
+    }
+    board.pins[i].wave = w;
+  }
+
+  HostNetwork &network = board.network;
+  network.cellularLatency = 10000 + 30000 * uniform(random);
+  network.cloudLatency = 2000 + 4000 * uniform(random);
+  network.cellularFailure = uniform(random) < .1 ? .3 : .02; // One in ten has poor coverage
+  network.publishFailure = .01;
+}
+
+// Runs one board until its virtual clock reaches the end, rebooting it whenever it resets itself
+static void run(Device &device, double end, bool monitor) {
+  timespec start, stop;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+  HostHal::select(&device.board);
+  while(HostHal::board().virtualClock < end) {
+    std::unique_ptr<Transmitter> transmitter(new Transmitter(device.linkStats, device.ledger));
+    try {
+      transmitter->setup();
+      transmitter->setMonitorPolling(monitor);
+      while(HostHal::board().virtualClock < end) {
+        transmitter->loop();
+      }
+    } catch(HostHal::Reset &) {
+      device.resets++;
+      HostHal::reboot();
+    }
+  }
+  HostHal::select(nullptr);
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &stop);
+  device.cpu = (stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+int main(int argc, char **argv) {
+  std::vector<const char *> numbers;
+  bool monitor = false;
+  bool serial = false;
+  for(int i = 1; i < argc; i++) {
+    if(strcmp(argv[i], "--monitor") == 0) monitor = true;
+    else if(strcmp(argv[i], "--serial") == 0) serial = true;
+    else numbers.push_back(argv[i]);
+  }
+  int count = numbers.size() > 0 ? atoi(numbers[0]) : 100;
+  double days = numbers.size() > 1 ? atof(numbers[1]) : 2;
+  unsigned int threads = numbers.size() > 2 ? atoi(numbers[2]) : std::max(1u, std::thread::hardware_concurrency());
+  if(count < 1 || days <= 0 || threads < 1) {
+    fprintf(stderr, "usage: fleet [devices] [days] [threads] [--monitor] [--serial]\n");
+    return 2;
+  }
+
+  std::vector<std::unique_ptr<Device>> devices;
+  for(int i = 0; i < count; i++) {
+    devices.push_back(std::unique_ptr<Device>(new Device()));
+  }
+  FleetCloud cloud(devices, days);
+  for(int i = 0; i < count; i++) {
+    configure(*devices[i], i, &cloud);
+  }
+  devices[0]->board.serialOn = serial;
+
+  printf("fleet: %d devices, %g days, %u threads%s\n", count, days, threads, monitor ? ", monitor polling" : "");
+  std::atomic<int> next(0);
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  std::vector<std::thread> pool;
+  for(unsigned int t = 0; t < threads; t++) {
+    pool.push_back(std::thread([&] {
+      for(int i = next++; i < count; i = next++) {
+        run(*devices[i], days * 24 * hour, monitor);
+      }
+    }));
+  }
+  for(size_t t = 0; t < pool.size(); t++) {
+    pool[t].join();
+  }
+  double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  double cpu = 0;
+  unsigned int resets = 0, resetBoards = 0;
+  for(int i = 0; i < count; i++) {
+    cpu += devices[i]->cpu;
+    resets += devices[i]->resets;
+    resetBoards += devices[i]->resets > 0;
+  }
+  double deviceDays = count * days;
+  printf("time         %.2f s wall, %.2f s CPU, %.1fx parallel, %.1f ms CPU per device-day, %.0f virtual days per s\n",
+    wall, cpu, cpu / wall, cpu / deviceDays * 1000, deviceDays / wall);
+  printf("resets       %u on %u boards\n", resets, resetBoards);
+  return cloud.report(deviceDays) ? 0 : 1;
+}
@@ -0,0 +1,268 @@
+/*
+
+  Stanford Engineers for a Sustainable World
+  Remote Monitoring System | August 2018
+
+  File: host/host_hal.cpp
+  --------------------------
+  Implementation of host_hal.h
+
+*/
+#include "application.h"
+#include <fstream>
+#include <sstream>
+
+HostSerial Serial;
+HostEEPROM EEPROM;
+HostCellular Cellular;
+HostParticle Particle;
+HostTime Time;
+HostSystem System;
+
+HostBoard::HostBoard() {
+  memset(eeprom, 0xFF, sizeof(eeprom));
+}
+
+namespace {
+  const double pi = 3.14159265358979323846;
+
+  thread_local HostBoard defaultBoard;
+  thread_local HostBoard *current = nullptr;
+
+  double noise() {
+    uint32_t &state = HostHal::board().noiseState;
+    state = state * 1664525u + 1013904223u;
+    return (double)(state >> 8) / (double)(1u << 24) * 2.0 - 1.0;
+  }
+
+  // [0, 1) from the board's own generator, so the noise of the waves does not depend on the network
+  double chance() {
+    uint32_t &state = HostHal::board().randomState;
+    state = state * 1664525u + 1013904223u;
+    return (double)(state >> 8) / (double)(1u << 24);
+  }
+
+  HostBoard::PinSource *source(int pin) {
+    int i = pin - HostHal::first_pin;
+    return i >= 0 && i < HostHal::pin_count ? &HostHal::board().pins[i] : nullptr;
+  }
+}
+
+namespace HostHal {
+
+HostBoard *select(HostBoard *board) {
+  HostBoard *last = current;
+  current = board;
+  return last;
+}
+
+HostBoard &board() {
+  return current ? *current : defaultBoard;
+}
+
+void reset() {
+  board() = HostBoard();
+}
+
+void reboot() {
+  HostBoard &b = board();
+  b.bootClock = b.virtualClock;
+  b.modemOn = false;
+  b.connecting = false;
+  b.cloudConnecting = false;
+  b.syncDone = 0;
+}
+
+uint64_t micros() {
+  return (uint64_t)(board().virtualClock - board().bootClock);
+}
+
+void advance(uint64_t us) {
+  board().virtualClock += us;
+}
+
+void setConversionTime(double us) {
+  board().conversionTime = us;
+}
+
+double trueValue(int pin, double t) {
+  HostBoard::PinSource *src = source(pin);
+  if(!src) {
+    return 0;
+  }
+  t += board().bootClock;
+  if(src->recorded) {
+    if(src->recording.empty()) {
+      return 0;
+    }
+    size_t i = (size_t)(t / src->interval) % src->recording.size();
+    return src->recording[i];
+  }
+  const HostWave &w = src->wave;
+  double u = w.outagePeriod > 0 ? fmod(t, w.outagePeriod) : t;
+  bool wrapped = w.outagePeriod > 0 && t >= w.outagePeriod && u + w.outagePeriod < w.outageEnd; // Tail of the last period's outage
+  if((u >= w.outageStart && u < w.outageEnd) || wrapped) {
+    return w.yShift;
+  }
+  double x = 2 * pi * (w.phase + w.frequency * t / 1e6 + w.chirp * t * t / 2e12);
+  double v = cos(x);
+  for(int h = 0; h < 8; h++) {
+    if(w.harmonics[h] != 0) {
+      v += w.harmonics[h] * cos((h + 2) * x);
+    }
+  }
+  if(w.rectified) {
+    v = fabs(v);
+  }
+  return w.yShift + w.amplitude * v;
+}
+
+int analogRead(int pin) {
+  int v = sampleAt(pin, micros());
+  board().virtualClock += board().conversionTime;
+  return v;
+}
+
+int sampleAt(int pin, double t) {
+  HostBoard::PinSource *src = source(pin);
+  double v = trueValue(pin, t);
+  if(src && !src->recorded && src->wave.noise > 0) {
+    v += src->wave.noise * noise();
+  }
+  if(v < 0) v = 0;
+  if(v > 4095) v = 4095;
+  return (int)(v + .5);
+}
+
+void setWave(int pin, const HostWave &wave) {
+  HostBoard::PinSource *src = source(pin);
+  if(src) {
+    src->recorded = false;
+    src->wave = wave;
+  }
+}
+
+void setRecording(int pin, const std::vector<uint16_t> &recording, double interval) {
+  HostBoard::PinSource *src = source(pin);
+  if(src) {
+    src->recorded = true;
+    src->recording = recording;
+    src->interval = interval;
+  }
+}
+
+// Format: first line "interval,<us>", then rows of comma separated ADC counts, column n feeding A<n>
+bool loadRecording(const char *path) {
+  std::ifstream file(path);
+  std::string line;
+  if(!std::getline(file, line) || line.compare(0, 9, "interval,") != 0) {
+    return false;
+  }
+  double interval = atof(line.c_str() + 9);
+  std::vector<std::vector<uint16_t>> columns;
+  while(std::getline(file, line)) {
+    std::stringstream row(line);
+    std::string cell;
+    for(size_t col = 0; std::getline(row, cell, ','); col++) {
+      if(columns.size() <= col) {
+        columns.resize(col + 1);
+      }
+      columns[col].push_back((uint16_t)atoi(cell.c_str()));
+    }
+  }
+  if(columns.empty() || interval <= 0) {
+    return false;
+  }
+  for(size_t col = 0; col < columns.size() && col < (size_t)pin_count; col++) {
+    setRecording(first_pin + col, columns[col], interval);
+  }
+  return true;
+}
+
+void setSerialEnabled(bool enabled) {
+  board().serialOn = enabled;
+}
+
+bool serialEnabled() {
+  return board().serialOn;
+}
+
+void cellularOn(bool on) {
+  HostBoard &b = board();
+  b.modemOn = on;
+  if(!on) {
+    b.connecting = false;
+    b.cloudConnecting = false;
+  }
+}
+
+void cellularConnect() {
+  HostBoard &b = board();
+  b.connecting = b.modemOn;
+  b.cellularFails = chance() < b.network.cellularFailure;
+  b.cellularReady = b.virtualClock + b.network.cellularLatency * 1000 * (.5 + chance());
+}
+
+bool cellularReady() {
+  HostBoard &b = board();
+  return b.connecting && !b.cellularFails && b.virtualClock >= b.cellularReady;
+}
+
+void cloudConnect() {
+  HostBoard &b = board();
+  b.cloudConnecting = cellularReady();
+  b.cloudReady = b.virtualClock + b.network.cloudLatency * 1000 * (.5 + chance());
+}
+
+void cloudDisconnect() {
+  board().cloudConnecting = false;
+}
+
+// The cloud sets the time as a board connects
+bool cloudConnected() {
+  HostBoard &b = board();
+  bool connected = b.cloudConnecting && cellularReady() && b.virtualClock >= b.cloudReady;
+  if(connected) {
+    b.timeValid = true;
+  }
+  return connected;
+}
+
+bool publish(const char *name, const char *data) {
+  HostBoard &b = board();
+  if(!cloudConnected()) {
+    return false;
+  }
+  b.virtualClock += b.network.publishTime * 1000;
+  if(chance() < b.network.publishFailure) {
+    return false;
+  }
+  return b.cloud ? b.cloud->publish(b.device, name, data, b.virtualClock) : true;
+}
+
+void syncTime() {
+  HostBoard &b = board();
+  b.syncDone = b.virtualClock + b.network.syncTime * 1000;
+}
+
+bool syncTimePending() {
+  HostBoard &b = board();
+  if(b.virtualClock < b.syncDone) {
+    return true;
+  }
+  if(cloudConnected()) {
+    b.timeValid = true;
+  }
+  return false;
+}
+
+uint32_t now() {
+  HostBoard &b = board();
+  return b.timeValid ? b.epoch + (uint32_t)(b.virtualClock / 1e6) : (uint32_t)((b.virtualClock - b.bootClock) / 1e6);
+}
+
+bool timeValid() {
+  return board().timeValid;
+}
+
+}
@@ -0,0 +1,130 @@
+/*
+
+  Stanford Engineers for a Sustainable World
+  Remote Monitoring System | August 2018
+
+  File: host/host_hal.h
+  --------------------------
+  Simulated sensorboard behind the host application.h. Time is virtual: it only moves when the
+  firmware reads the ADC (one conversion time per analogRead) or delays, so captures come out with
+  the same sample spacing as on an Electron no matter how fast the host is.
+  Each analog pin is fed by either a synthetic wave or a recorded capture.
+
+  Everything a board has - its pins, clock, EEPROM, modem and cloud connection - is one HostBoard.
+  Each thread calls into the board it selected, its own default board until it selects another, so
+  host/fleet.cpp can run many boards on a thread pool. The modem and cloud are a simple model:
+  connects and publishes take their latency in virtual time and fail at a given rate.
+
+*/
+
+#ifndef HOST_HAL_H
+#define HOST_HAL_H
+
+#include <stdint.h>
+#include <vector>
+
+struct HostWave {
+  double yShift = 0;        // ADC counts
+  double amplitude = 0;     // Peak ADC counts of the fundamental
+  double frequency = 50;    // Hz at t = 0
+  double chirp = 0;         // Hz/s, frequency drift
+  double phase = 0;         // Cycles
+  bool rectified = false;
+  double harmonics[8] = {}; // Relative amplitude of harmonics 2..9
+  double noise = 0;         // Uniform noise, peak ADC counts
+  double outageStart = 0;   // us, the wave sits at yShift from here
+  double outageEnd = 0;     // to here
+  double outagePeriod = 0;  // us, the outage repeats this often if not 0, e.g. a generator off every night. It may run past the period
+};
+
+struct HostNetwork {
+  double cellularLatency = 20000;  // ms from Cellular.connect() to ready, each connect takes .5-1.5 of it
+  double cloudLatency = 3000;      // ms from Particle.connect() to connected, likewise
+  double publishTime = 300;        // ms each Particle.publish() blocks
+  double syncTime = 1500;          // ms a Particle.syncTime() is pending
+  double cellularFailure = 0;      // Chance a Cellular.connect() never becomes ready
+  double publishFailure = 0;       // Chance a publish is not acknowledged
+};
+
+// Where a board's publishes go, called from the thread running the board
+class HostCloud {
+public:
+  virtual bool publish(int device, const char *name, const char *data, double t) = 0; // t in us of virtual time, false rejects it
+};
+
+struct HostBoard {
+  struct PinSource {
+    bool recorded = false;
+    HostWave wave;
+    std::vector<uint16_t> recording;
+    double interval = 1;
+  };
+  static const int pin_count = 8;
+  static const int eeprom_size = 2047; // Same size as the Electron's emulated EEPROM
+
+  HostBoard();
+
+  PinSource pins[pin_count];
+  double virtualClock = 0; // us
+  double bootClock = 0; // virtualClock at the last boot, micros() counts from here
+  double conversionTime = 91.25; // ~365us per 4 channel sample on an Electron
+  bool acquisitionStalls = false; // The DMA never delivers a block, Acquisition times out
+  bool serialOn = false;
+  uint32_t noiseState = 1;
+  uint8_t eeprom[eeprom_size];
+
+  int device = 0;
+  HostCloud *cloud = nullptr;
+  HostNetwork network;
+  uint32_t epoch = 1533081600; // Unix time at virtual 0, August 2018
+  bool timeValid = false; // Set once the cloud has synced it, survives resets like the RTC
+  bool modemOn = false;
+  bool connecting = false;
+  bool cellularFails = false;
+  double cellularReady = 0; // virtualClock it becomes ready
+  bool cloudConnecting = false;
+  double cloudReady = 0;
+  double syncDone = 0;
+  uint32_t randomState = 1;
+};
+
+namespace HostHal {
+  static const int pin_count = HostBoard::pin_count;
+  static const int first_pin = 10; // A0
+
+  struct Reset {}; // Thrown by System.reset(), the board reboots where it is caught
+
+  HostBoard *select(HostBoard *board); // Board this thread's calls go to, nullptr for its default. Returns the last one
+  HostBoard &board();
+  void reset(); // Clears the board as if new
+  void reboot(); // After a Reset, micros() starts over and the modem is off, EEPROM and time are kept
+
+  uint64_t micros();
+  void advance(uint64_t us);
+  void setConversionTime(double us); // Virtual time per analogRead
+  int analogRead(int pin);
+  int sampleAt(int pin, double t); // What a conversion at t (us) reads, without moving the clock
+
+  void setWave(int pin, const HostWave &wave);
+  void setRecording(int pin, const std::vector<uint16_t> &recording, double interval); // interval in us
+  bool loadRecording(const char *path); // CSV with an interval header, one column per analog pin
+  double trueValue(int pin, double t); // Noise free signal at t (us)
+
+  void setSerialEnabled(bool enabled);
+  bool serialEnabled();
+
+  // Modem and cloud, see HostNetwork
+  void cellularOn(bool on);
+  void cellularConnect();
+  bool cellularReady();
+  void cloudConnect();
+  void cloudDisconnect();
+  bool cloudConnected();
+  bool publish(const char *name, const char *data);
+  void syncTime();
+  bool syncTimePending();
+  uint32_t now(); // Unix time, seconds since boot while it is not valid
+  bool timeValid();
+}
+
+#endif
@@ -0,0 +1,340 @@
+/*
+
+  Stanford Engineers for a Sustainable World
+  Remote Monitoring System | August 2018
+
+  File: host/replay.cpp
+  --------------------------
+  Runs captures (capture.h) back through the analysis and compares what it makes of them with the
+  results stored in them. Files may hold any number of captures with anything in between, so a
+  serial log of a board built with DUMPCAPTURES can be replayed as it is. Exits 1 if any capture
+  is damaged or any result moved further than a tolerance, which makes host/corpus a regression suite.
+
+  Usage: replay [--update] capture ...            --update stores the new results, keeping only the captures
+         replay --make-corpus <dir>               writes the synthetic captures of host/corpus
+         replay --convert <recording.csv> <out>   captures a bench recording (see host_hal.h)
+
+  Captures only replay on a build whose site_config.h table matches the one they were taken with,
+  others are skipped. Each capture is analysed cold, without the warm start of the one before.
+
+*/
+#include "application.h"
+#include "sensors.h"
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+class FileCaptureSink : public CaptureSink {
+public:
+  FileCaptureSink(const std::string &path) : file(path.c_str(), std::ios::binary) {}
+  void write(const uint8_t *data, unsigned int length) {
+    file.write((const char *)data, length);
+  }
+  bool good() {
+    return file.good();
+  }
+
+private:
+  std::ofstream file;
+};
+
+static HostWave wave(double yShift, double amplitude, double frequency, double phase, bool rectified, double noise) {
+  HostWave w;
+  w.yShift = yShift;
+  w.amplitude = amplitude;
+  w.frequency = frequency;
+  w.phase = phase;
+  w.rectified = rectified;
+  w.noise = noise;
+  return w;
+}
+
+struct CorpusCapture {
+  const char *name;
+  HostWave waves[4];
+};
+
+// Conditions the analysis has to keep handling, yShift and rectification match SITE_BENCH
+static std::vector<CorpusCapture> corpus() {
+  std::vector<CorpusCapture> list;
+  CorpusCapture nominal = {"nominal-50hz", {wave(-321, 1300, 50, .1, true, 5), wave(1975, 600, 50, .3, false, 5), wave(1975, 600, 50, .63, false, 5), wave(1975, 600, 50, .97, false, 5)}};
+  CorpusCapture sixty = {"nominal-60hz", {wave(-321, 1320, 60, .4, true, 5), wave(1975, 800, 60, .45, false, 5), wave(1975, 780, 60, .78, false, 5), wave(1975, 820, 60, .12, false, 5)}};
+  CorpusCapture light = {"light-load-47hz", {wave(-321, 1250, 47.3, .2, true, 20), wave(1975, 150, 47.3, .35, false, 15), wave(1975, 120, 47.3, .7, false, 15), wave(1975, 90, 47.3, .02, false, 15)}};
+  CorpusCapture harmonics = {"harmonics-62hz", {wave(-321, 1350, 61.7, .45, true, 10), wave(1975, 900, 61.7, .5, false, 10), wave(1975, 850, 61.7, .83, false, 10), wave(1975, 800, 61.7, .16, false, 10)}};
+  for(int i = 1; i < 4; i++) {
+    harmonics.waves[i].harmonics[1] = .08; // 3rd
+    harmonics.waves[i].harmonics[3] = .04; // 5th
+  }
+  CorpusCapture slow = {"band-edge-41hz", {wave(-321, 1300, 40.5, .9, true, 10), wave(1975, 1500, 40.5, .1, false, 10), wave(1975, 40, 40.5, .4, false, 10), wave(1975, 1900, 40.5, .75, false, 10)}};
+  CorpusCapture fast = {"band-edge-66hz", {wave(-321, 1280, 66, .6, true, 10), wave(1975, 500, 66, .2, false, 10), wave(1975, 500, 66, .55, false, 10), wave(1975, 500, 66, .88, false, 10)}};
+  CorpusCapture sagging = {"sagging-52hz", {wave(-321, 1300, 52, .3, true, 10), wave(1975, 700, 52, .35, false, 10), wave(1975, 700, 52, .68, false, 10), wave(1975, 700, 52, .02, false, 10)}};
+  for(int i = 0; i < 4; i++) {
+    sagging.waves[i].chirp = -.5;
+  }
+  CorpusCapture unbalanced = {"unbalanced-55hz", {wave(-321, 1200, 55, .05, true, 15), wave(1975, 1700, 55, .25, false, 15), wave(1975, 300, 55, .6, false, 15), wave(1975, 0, 55, 0, false, 15)}};
+  CorpusCapture noisy = {"noisy-49hz", {wave(-321, 1300, 49.2, .7, true, 60), wave(1975, 500, 49.2, .8, false, 50), wave(1975, 500, 49.2, .13, false, 50), wave(1975, 500, 49.2, .47, false, 50)}};
+  CorpusCapture flat = {"no-signal", {wave(-321, 0, 50, 0, true, 5), wave(1975, 0, 50, 0, false, 5), wave(1975, 0, 50, 0, false, 5), wave(1975, 0, 50, 0, false, 5)}};
+  CorpusCapture tripping = {"tripping-50hz", {wave(-321, 1300, 50, .2, true, 5), wave(1975, 600, 50, .4, false, 5), wave(1975, 600, 50, .73, false, 5), wave(1975, 600, 50, .07, false, 5)}};
+  for(int i = 0; i < 4; i++) {
+    tripping.waves[i].outageStart = 200000;
+    tripping.waves[i].outageEnd = 1e9;
+  }
+  list.push_back(nominal);
+  list.push_back(sixty);
+  list.push_back(light);
+  list.push_back(harmonics);
+  list.push_back(slow);
+  list.push_back(fast);
+  list.push_back(sagging);
+  list.push_back(unbalanced);
+  list.push_back(noisy);
+  list.push_back(flat);
+  list.push_back(tripping);
+  return list;
+}
+
+class CaptureReplay {
+public:
+  static constexpr double periodTolerance = 2; // us
+  static constexpr double amplitudeTolerance = .005; // Relative
+  static const int xShiftTolerance = 20; // Ten thousandths of a cycle
+
+  CaptureReplay(Sensors &sensors) : sensors(sensors), count(0), skipped(0), regressions(0), total(0), worst(0) {}
+
+  // Whether this build's site table is the one the capture was taken with
+  bool matchesSite(const Capture &capture) {
+    if(capture.channels != scan_length) {
+      return false;
+    }
+    for(unsigned int k = 0; k < capture.channels; k++) {
+      const CaptureChannel &c = capture.channel[k];
+      if(c.input >= Sensors::input_count || !isRecorded(c.input) || scanPosition(c.input) != k) {
+        return false;
+      }
+      const ChannelConfig &in = site_channels[c.input];
+      if(c.pin != in.pin || c.yShift != in.yShift || c.waveMin != in.waveMin || c.waveMax != in.waveMax
+        || (c.flags & capture_rectified) != (in.rectified ? capture_rectified : 0) || (c.flags & capture_ignored) != (in.ignore ? capture_ignored : 0)
+        || c.a != (float)in.a || c.b != (float)in.b || c.c != (float)in.c || c.maxError != (float)in.maxError) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Feeds the capture's samples to the simulated board at its interval and runs one measurement attempt
+  void replay(const Capture &capture) {
+    HostHal::reset();
+    for(unsigned int k = 0; k < capture.channels; k++) {
+      const CaptureChannel &c = capture.channel[k];
+      HostHal::setRecording(c.pin, std::vector<uint16_t>(c.samples, c.samples + capture.count), capture.interval);
+    }
+    int pins[Acquisition::max_channels];
+    for(unsigned int k = 0; k < capture.channels; k++) {
+      pins[k] = capture.channel[k].pin;
+    }
+    sensors.warmStart = Sensors::WarmStart();
+    sensors.init();
+    sensors.acquisition.begin(pins, capture.channels, (unsigned int)(capture.interval + .5));
+    measure();
+  }
+
+  // One attempt of refreshAll(), the analysis is timed
+  void measure() {
+    sensors.recordSamples();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    bool generatorOn = sensors.checkStatus(sensors.sampleCount);
+    if(generatorOn) {
+      sensors.analyzeSmoothedWaves();
+      sensors.analyzeSpectrum();
+      sensors.bruteforceFrequencies();
+      sensors.bruteforceAmplitudes();
+    } else {
+      sensors.zeroMeasurements();
+    }
+    if(sensors.measurementsValid && generatorOn) {
+      sensors.calculatePower();
+    }
+    lastTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  // Prints how the replay compares with the stored results, returns false if any moved too far
+  bool compare(const char *name, const Capture &capture) {
+    std::string problems;
+    bool valid = (capture.flags & capture_valid) != 0;
+    bool on = (capture.flags & capture_generator_on) != 0;
+    if(sensors.sampleCount != capture.count) {
+      problems += " window";
+    }
+    if(sensors.measurementsValid != valid || sensors.checkStatus(sensors.sampleCount) != on) {
+      problems += " validity";
+    }
+    if(fabs((double)sensors.period - capture.period) > periodTolerance) {
+      problems += " period";
+    }
+    for(unsigned int k = 0; on && valid && k < capture.channels; k++) {
+      const CaptureChannel &c = capture.channel[k];
+      if(c.flags & capture_ignored) {
+        continue;
+      }
+      const Sensors::Measurement &m = sensors.input[c.input];
+      int cycle = (c.flags & capture_rectified) ? sensors.xShiftRangeMax / 2 : sensors.xShiftRangeMax;
+      int drift = ((int)m.xShift - c.xShift) % cycle;
+      drift = abs(drift) > cycle / 2 ? cycle - abs(drift) : abs(drift);
+      if(fabs((double)m.amplitude - c.amplitude) > amplitudeTolerance * c.amplitude || drift > xShiftTolerance) {
+        problems += " input " + std::to_string(c.input);
+      }
+    }
+    printf("%-40s %4u samples  period %5u -> %5u us  %s  %7.3f ms%s%s\n", name, capture.count, capture.period, sensors.period,
+      sensors.measurementsValid ? "valid  " : "invalid", lastTime, problems.empty() ? "" : "  REGRESSION:", problems.c_str());
+    return problems.empty();
+  }
+
+  // Replays every capture in a file, rewriting it with the new results if update is set
+  bool replayFile(const char *path, bool update) {
+    std::ifstream file(path, std::ios::binary);
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if(!file.good() && !file.eof()) {
+      fprintf(stderr, "Could not read %s\n", path);
+      return false;
+    }
+    std::vector<uint8_t> updated;
+    bool ok = true;
+    unsigned int found = 0;
+    unsigned int offset = 0;
+    int next;
+    while((next = findCapture(data.data() + offset, data.size() - offset)) >= 0) {
+      offset += next;
+      Capture capture;
+      unsigned int size = readCapture(data.data() + offset, data.size() - offset, capture, storage, sizeof(storage) / sizeof(storage[0]));
+      std::string name = std::string(path) + "#" + std::to_string(found++);
+      if(size == 0) {
+        printf("%-40s damaged\n", name.c_str());
+        ok = false;
+        offset += 4;
+        continue;
+      }
+      offset += size;
+      if(!matchesSite(capture)) {
+        printf("%-40s skipped, taken with another site_config.h table\n", name.c_str());
+        skipped++;
+        updated.insert(updated.end(), data.begin() + offset - size, data.begin() + offset);
+        continue;
+      }
+      replay(capture);
+      count++;
+      total += lastTime;
+      worst = lastTime > worst ? lastTime : worst;
+      if(update) {
+        VectorCaptureSink sink(updated);
+        sensors.writeCapture(sink, capture.time);
+        printf("%-40s %4u samples  period %5u us  %7.3f ms  updated\n", name.c_str(), sensors.sampleCount, sensors.period, lastTime);
+      } else if(!compare(name.c_str(), capture)) {
+        regressions++;
+        ok = false;
+      }
+    }
+    if(found == 0) {
+      fprintf(stderr, "No captures in %s\n", path);
+      return false;
+    }
+    if(update && !updated.empty()) {
+      std::ofstream out(path, std::ios::binary | std::ios::trunc);
+      out.write((const char *)updated.data(), updated.size());
+      ok = ok && out.good();
+    }
+    return ok;
+  }
+
+  // Writes the synthetic captures of corpus() to dir
+  bool makeCorpus(const std::string &dir) {
+    std::vector<CorpusCapture> list = corpus();
+    for(size_t s = 0; s < list.size(); s++) {
+      HostHal::reset();
+      for(int i = 0; i < 4; i++) {
+        HostHal::setWave(A0 + i, list[s].waves[i]);
+      }
+      sensors.init();
+      measure();
+      if(!save(dir + "/" + list[s].name + ".cap")) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Captures a recording in the host_hal.h CSV format
+  bool convert(const char *recording, const std::string &path) {
+    HostHal::reset();
+    if(!HostHal::loadRecording(recording)) {
+      fprintf(stderr, "Could not read recording %s\n", recording);
+      return false;
+    }
+    sensors.init();
+    measure();
+    return save(path);
+  }
+
+  void printSummary() {
+    printf("\n%u captures replayed, %u skipped, %u regressions, analysis mean %.3f ms, worst %.3f ms\n",
+      count, skipped, regressions, count ? total / count : 0, worst);
+  }
+
+private:
+  bool save(const std::string &path) {
+    FileCaptureSink sink(path);
+    sensors.writeCapture(sink, 0);
+    if(!sink.good()) {
+      fprintf(stderr, "Could not write %s\n", path.c_str());
+      return false;
+    }
+    printf("%-40s %4u samples  period %5u us\n", path.c_str(), sensors.sampleCount, sensors.period);
+    return true;
+  }
+
+  class VectorCaptureSink : public CaptureSink {
+  public:
+    VectorCaptureSink(std::vector<uint8_t> &out) : out(out) {}
+    void write(const uint8_t *data, unsigned int length) {
+      out.insert(out.end(), data, data + length);
+    }
+
+  private:
+    std::vector<uint8_t> &out;
+  };
+
+  Sensors &sensors;
+  sample_t storage[capture_max_channels * Sensors::measurement_samples];
+  double lastTime;
+  unsigned int count;
+  unsigned int skipped;
+  unsigned int regressions;
+  double total;
+  double worst;
+};
+
+int main(int argc, char **argv) {
+  static Sensors sensors; // Too big for the stack, same as on the Electron
+  static CaptureReplay replay(sensors);
+  std::string first = argc > 1 ? argv[1] : "";
+
+  if(first == "--make-corpus" && argc == 3) {
+    return replay.makeCorpus(argv[2]) ? 0 : 1;
+  }
+  if(first == "--convert" && argc == 4) {
+    return replay.convert(argv[2], argv[3]) ? 0 : 1;
+  }
+
+  bool update = first == "--update";
+  if(argc < (update ? 3 : 2)) {
+    fprintf(stderr, "Usage: replay [--update] capture ...\n       replay --make-corpus <dir>\n       replay --convert <recording.csv> <out>\n");
+    return 1;
+  }
+  bool ok = true;
+  for(int i = update ? 2 : 1; i < argc; i++) {
+    ok = replay.replayFile(argv[i], update) && ok;
+  }
+  replay.printSummary();
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,126 @@
+/*
+
+  Stanford Engineers for a Sustainable World
+  Remote Monitoring System | August 2018
+
+  File: measurement_log.cpp
+  --------------------------
+  Implementation of measurement_log.h
+
+*/
+#include "application.h"
+#include "measurement_log.h"
+
+static_assert(sizeof(LogRecord) == 16, "LogRecord must pack to 16 bytes");
+
+MeasurementLog::MeasurementLog() {
+    head = 0;
+    headSlot = 0;
+    tail = 0;
+    stored = 0;
+}
+
+void MeasurementLog::init() {
+    bool found = false;
+    uint16_t newest = 0;
+    uint16_t oldest = 0;
+    unsigned int newestSlot = 0;
+    // Everything in the slots was written within the last capacity appends, so sequences compare as
+    // 16 bit differences even after they wrap
+    for(unsigned int slot = 0; slot < capacity; slot++) {
+        LogRecord record;
+        EEPROM.get(log_start + slot * sizeof(LogRecord), record);
+        if(record.crc != recordCrc(record)) {
+            continue;
+        }
+        if(!found || (int16_t)(record.sequence - newest) > 0) {
+            newest = record.sequence;
+            newestSlot = slot;
+        }
+        if(!found || (int16_t)(record.sequence - oldest) < 0) {
+            oldest = record.sequence;
+        }
+        found = true;
+    }
+
+    TailCell cell;
+    EEPROM.get(tail_address, cell);
+    bool cellValid = cell.check == (uint16_t)~cell.sequence;
+    if(found) {
+        head = newest + 1;
+        headSlot = (newestSlot + 1) % capacity;
+        stored = (uint16_t)(head - oldest);
+    } else {
+        head = cellValid ? cell.sequence : 0;
+        headSlot = 0;
+        stored = 0;
+    }
+    // Unpublished records that were overwritten are gone, publishing resumes at the oldest one left
+    if(cellValid && (uint16_t)(head - cell.sequence) <= stored) {
+        tail = cell.sequence;
+    } else {
+        tail = head - stored;
+    }
+}
+
+void MeasurementLog::append(LogRecord record) {
+    if(stored == capacity) {
+        if(tail == (uint16_t)(head - capacity)) {
+            tail++; // Overwriting the oldest unpublished record
+        }
+    } else {
+        stored++;
+    }
+    record.sequence = head;
+    record.crc = recordCrc(record);
+    EEPROM.put(log_start + headSlot * sizeof(LogRecord), record);
+    head++;
+    headSlot = (headSlot + 1) % capacity;
+}
+
+unsigned int MeasurementLog::pending() {
+    return (uint16_t)(head - tail);
+}
+
+bool MeasurementLog::read(unsigned int index, LogRecord &record) {
+    if(index >= pending()) {
+        return false;
+    }
+    uint16_t sequence = tail + index;
+    EEPROM.get(address(sequence), record);
+    return record.sequence == sequence && record.crc == recordCrc(record);
+}
+
+void MeasurementLog::markPublished(unsigned int count) {
+    unsigned int available = pending();
+    tail += count < available ? count : available;
+    saveTail();
+}
+
+// CRC-16/CCITT
+uint16_t MeasurementLog::crc16(const uint8_t *data, unsigned int length, uint16_t crc) {
+    for(unsigned int i = 0; i < length; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for(int bit = 0; bit < 8; bit++) {
+            crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+// Everything but the crc field itself, an erased slot never matches
+uint16_t MeasurementLog::recordCrc(const LogRecord &record) {
+    return crc16((const uint8_t *)&record, sizeof(LogRecord) - sizeof(record.crc));
+}
+
+int MeasurementLog::address(uint16_t sequence) {
+    unsigned int back = (uint16_t)(head - sequence);
+    return log_start + ((headSlot + capacity - back % capacity) % capacity) * sizeof(LogRecord);
+}
+
+void MeasurementLog::saveTail() {
+    TailCell cell;
+    cell.sequence = tail;
+    cell.check = ~tail;
+    EEPROM.put(tail_address, cell);
+}
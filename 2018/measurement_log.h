@@ -0,0 +1,70 @@
+/*
+
+  Stanford Engineers for a Sustainable World
+  Remote Monitoring System | August 2018
+
+  File: measurement_log.h
+  --------------------------
+  Append-only log of compressed measurements in the EEPROM below the status strings. Every record
+  carries a sequence number and a CRC and goes in with one EEPROM.put, into the slot after the newest
+  one, overwriting the oldest once the area is full. At boot the slots are scanned once: the valid
+  record with the highest sequence is the head, and the oldest unpublished sequence is kept in a
+  checked control cell. A record that fails its CRC is skipped on its own instead of corrupting the
+  ones around it.
+
+*/
+
+#ifndef MEASUREMENT_LOG_H
+#define MEASUREMENT_LOG_H
+
+#include <stdint.h>
+
+struct LogRecord {
+  uint16_t  sequence; // Set by append()
+  uint16_t  current_1;
+  uint16_t  current_2;
+  uint16_t  current_3;
+  uint16_t  frequency;
+  uint16_t  voltage;
+  uint16_t  power;
+  uint16_t  crc; // Set by append()
+};
+
+class MeasurementLog {
+public:
+/**********************************  SETUP  ***********************************/
+  MeasurementLog();
+
+/********************************  FUNCTIONS  *********************************/
+  void    init(); // Finds the head and the publish position, call once at boot
+  void    append(LogRecord record);
+  unsigned int  pending(); // Records not yet published, oldest first
+  bool    read(unsigned int index, LogRecord &record); // index 0 is the oldest pending record, false if it is corrupt
+  void    markPublished(unsigned int count); // Drops the oldest count records from pending
+
+  static const int log_start = 0;
+  static const int log_end = 1800; // Status strings start here
+  static const int tail_address = 2010;
+  static const unsigned int capacity = (log_end - log_start) / sizeof(LogRecord);
+
+  static uint16_t crc16(const uint8_t *data, unsigned int length, uint16_t crc = 0xFFFF); // Pass the last result to continue a crc
+
+private:
+/*********************************  HELPERS  **********************************/
+  static uint16_t recordCrc(const LogRecord &record);
+  int     address(uint16_t sequence); // Of a sequence inside the live window
+  void    saveTail();
+
+/*********************************  OBJECTS  **********************************/
+  struct TailCell {
+    uint16_t  sequence;
+    uint16_t  check; // ~sequence
+  };
+
+  uint16_t  head; // Sequence the next record gets
+  unsigned int  headSlot; // Slot it goes to
+  uint16_t  tail; // Oldest unpublished sequence
+  unsigned int  stored; // Records in the live window, at most capacity
+};
+
+#endif
@@ -0,0 +1,73 @@
+/*
+
+  Stanford Engineers for a Sustainable World
+  Remote Monitoring System | August 2018
+
+  File: payload.cpp
+  --------------------------
+  Implementation of payload.h
+
+*/
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "payload.h"
+
+PayloadWriter::PayloadWriter(char *buffer, unsigned int capacity) {
+    this->buffer = buffer;
+    this->capacity = capacity;
+    clear();
+}
+
+void PayloadWriter::clear() {
+    used = 0;
+    overflow = false;
+    if(capacity > 0) {
+        buffer[0] = 0;
+    }
+}
+
+bool PayloadWriter::append(const char *text) {
+    unsigned int n = strlen(text);
+    if(used + n + 1 > capacity) {
+        overflow = true;
+        return false;
+    }
+    memcpy(buffer + used, text, n + 1);
+    used += n;
+    return true;
+}
+
+bool PayloadWriter::appendf(const char *format, ...) {
+    if(used + 1 > capacity) {
+        overflow = true;
+        return false;
+    }
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(buffer + used, capacity - used, format, args);
+    va_end(args);
+    if(n < 0 || used + n + 1 > capacity) {
+        buffer[used] = 0; // Drop the part that fit
+        overflow = true;
+        return false;
+    }
+    used += n;
+    return true;
+}
+
+const char *PayloadWriter::c_str() const {
+    return buffer;
+}
+
+unsigned int PayloadWriter::length() const {
+    return used;
+}
+
+bool PayloadWriter::isEmpty() const {
+    return used == 0;
+}
+
+bool PayloadWriter::overflowed() const {
+    return overflow;
+}
@@ -0,0 +1,48 @@
+/*
+
+  Stanford Engineers for a Sustainable World
+  Remote Monitoring System | August 2018
+
+  File: payload.h
+  --------------------------
+  Fixed-capacity text builder for publishes and EEPROM strings, used instead of String so building a
+  payload never touches the heap. Each append goes in whole or not at all: one that does not fit
+  leaves the text as it was, returns false and marks the writer as overflowed.
+
+*/
+
+#ifndef PAYLOAD_H
+#define PAYLOAD_H
+
+class PayloadWriter {
+public:
+/**********************************  SETUP  ***********************************/
+  PayloadWriter(char *buffer, unsigned int capacity); // capacity includes the terminator
+
+/********************************  FUNCTIONS  *********************************/
+  void    clear();
+  bool    append(const char *text);
+  bool    appendf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+  const char *  c_str() const;
+  unsigned int  length() const;
+  bool    isEmpty() const;
+  bool    overflowed() const; // Since the last clear()
+
+private:
+/*********************************  OBJECTS  **********************************/
+  char *buffer;
+  unsigned int capacity;
+  unsigned int used;
+  bool overflow;
+};
+
+// A writer with its own buffer of Capacity characters
+template <unsigned int Capacity> class Payload : public PayloadWriter {
+public:
+  Payload() : PayloadWriter(storage, Capacity + 1) {}
+
+private:
+  char storage[Capacity + 1];
+};
+
+#endif
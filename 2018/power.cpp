@@ -0,0 +1,129 @@
+/*
+
+  Stanford Engineers for a Sustainable World
+  Remote Monitoring System | August 2018
+
+  File: power.cpp
+  --------------------------
+  Implementation of power.h
+
+*/
+#include <cmath>
+#include "power.h"
+
+PowerAccumulator::PowerAccumulator() {
+    begin(max_channels, false, 0, 0);
+}
+
+void PowerAccumulator::begin(unsigned int channels, bool rectified, int yShift, int lowLevel) {
+    this->channels = channels > max_channels ? max_channels : channels;
+    this->rectified = rectified;
+    this->yShift = yShift;
+    this->lowLevel = lowLevel;
+    sign = 1;
+    low = false;
+    longTrough = false;
+    troughLength = 0;
+    scanLength = this->channels;
+    n = 0;
+    firstU = 0;
+    previousU = 0;
+    for(unsigned int j = 0; j < max_channels; j++) {
+        previous[j] = 0;
+        sum[j] = 0;
+        sumSquares[j] = 0;
+        sumProducts[j] = 0;
+        early[j] = scanLength - j;
+        late[j] = j;
+    }
+}
+
+void PowerAccumulator::setReadOrder(unsigned int channel, unsigned int position, unsigned int scanLength) {
+    if(channel < max_channels && position < scanLength) {
+        this->scanLength = scanLength;
+        early[channel] = scanLength - position;
+        late[channel] = position;
+    }
+}
+
+void PowerAccumulator::addTrough(const sample_t *scan) {
+    if(!low) {
+        low = true;
+        longTrough = false;
+        troughLength = 0;
+    }
+    if(scan[0] > lowLevel + hysteresis) {
+        // Out of the trough
+        low = false;
+        if(longTrough) {
+            sign = -sign;
+        } else {
+            flushTrough(-sign);
+        }
+        accumulate(sign * (scan[0] - yShift), scan);
+    } else if(longTrough) {
+        accumulate(sign * (scan[0] - yShift), scan);
+    } else if(troughLength == trough_max) {
+        flushTrough(sign);
+        longTrough = true;
+        accumulate(sign * (scan[0] - yShift), scan);
+    } else {
+        for(unsigned int j = 0; j < channels; j++) {
+            trough[troughLength][j] = scan[j];
+        }
+        troughLength++;
+    }
+}
+
+// Adds the held scans, switching to secondHalfSign half way through, and keeps that sign
+void PowerAccumulator::flushTrough(int secondHalfSign) {
+    for(unsigned int i = 0; i < troughLength; i++) {
+        if(i == troughLength / 2) {
+            sign = secondHalfSign;
+        }
+        accumulate(sign * (trough[i][0] - yShift), trough[i]);
+    }
+    sign = secondHalfSign;
+    troughLength = 0;
+}
+
+void PowerAccumulator::finish() {
+    if(low && !longTrough) {
+        flushTrough(sign);
+    }
+    low = false;
+}
+
+// A rectified voltage is already measured from its zero, everything else is measured from its mean
+double PowerAccumulator::getRms(unsigned int channel) const {
+    if(channel >= channels || n == 0) {
+        return 0;
+    }
+    double meanSquare = (double)sumSquares[channel] / n;
+    if(channel > 0 || !rectified) {
+        double mean = (double)sum[channel] / n;
+        meanSquare -= mean * mean;
+    }
+    return meanSquare > 0 ? sqrt(meanSquare) : 0;
+}
+
+// Covariance of the interpolated voltage and the current over the n - 1 scans that have products
+double PowerAccumulator::getRealPower(unsigned int channel) const {
+    if(channel == 0 || channel >= channels || n < 2) {
+        return 0;
+    }
+    double rows = n - 1;
+    double meanU = ((double)(sum[0] - previousU) * early[channel] + (double)(sum[0] - firstU) * late[channel]) / (scanLength * rows);
+    double meanI = (double)(sum[channel] - previous[channel]) / rows;
+    double power = (double)sumProducts[channel] / (scanLength * rows) - meanU * meanI;
+    return rectified ? fabs(power) : power;
+}
+
+double PowerAccumulator::getPowerFactor(unsigned int channel) const {
+    double apparent = getRms(0) * getRms(channel);
+    if(apparent <= 0) {
+        return 0;
+    }
+    double pf = getRealPower(channel) / apparent;
+    return pf > 1 ? 1 : (pf < -1 ? -1 : pf);
+}
@@ -0,0 +1,105 @@
+/*
+
+  Stanford Engineers for a Sustainable World
+  Remote Monitoring System | August 2018
+
+  File: power.h
+  --------------------------
+  Streaming true RMS and real power. Each scan of all inputs is added as it is recorded, keeping sums
+  of readings, squared readings and voltage x current products, so RMS and power are known when the
+  capture ends without fitting a wave.
+
+  Input 0 is the voltage, the others are currents. The inputs of a scan are read one after another,
+  so each current is multiplied by the voltage interpolated to the moment that current was read.
+  By default channel j is the j-th read of the scan, setReadOrder() covers boards that skip inputs.
+  A rectified voltage loses its sign, which has to flip at the bottom of every trough. Scans inside a
+  trough (below lowLevel) are held back until the wave climbs out, then the first half keeps the old
+  sign and the second half gets the new one. That leaves the overall sign unknown, so real power is
+  reported as a magnitude for rectified voltages.
+
+*/
+
+#ifndef POWER_H
+#define POWER_H
+
+#include "sample.h"
+
+class PowerAccumulator {
+public:
+/**********************************  SETUP  ***********************************/
+  PowerAccumulator();
+
+/********************************  FUNCTIONS  *********************************/
+  void    begin(unsigned int channels, bool rectified, int yShift, int lowLevel);
+  void    setReadOrder(unsigned int channel, unsigned int position, unsigned int scanLength); // After begin(), if not every channel is read
+  void    add(const sample_t *scan) {
+    if(!rectified) {
+      accumulate(scan[0], scan);
+    } else if(low || scan[0] < lowLevel) {
+      addTrough(scan);
+    } else {
+      accumulate(sign * (scan[0] - yShift), scan);
+    }
+  }
+  void    finish(); // Call once the capture is over to add any scans still held in a trough
+  double  getRms(unsigned int channel) const; // ADC counts
+  double  getRealPower(unsigned int channel) const; // Mean voltage x current in ADC counts squared
+  double  getPowerFactor(unsigned int channel) const;
+
+  static const unsigned int max_channels = 4;
+
+private:
+/*********************************  HELPERS  **********************************/
+  typedef SampleTraits<sample_t>::value_t value_t;
+  typedef SampleTraits<sample_t>::sum_t sum_t;
+
+  void    addTrough(const sample_t *scan);
+  void    flushTrough(int secondHalfSign);
+  void    accumulate(value_t u, const sample_t *scan) {
+    if(n > 0) {
+      // Products for the previous scan, voltage interpolated to when each current was read
+      for(unsigned int j = 1; j < channels; j++) {
+        sumProducts[j] += (sum_t)(previousU * early[j] + u * late[j]) * previous[j];
+      }
+    } else {
+      firstU = u;
+    }
+    sum[0] += u;
+    sumSquares[0] += (sum_t)u * u;
+    for(unsigned int j = 1; j < channels; j++) {
+      sum[j] += scan[j];
+      sumSquares[j] += (sum_t)scan[j] * scan[j];
+      previous[j] = scan[j];
+    }
+    previousU = u;
+    n++;
+  }
+
+/*********************************  OBJECTS  **********************************/
+  static const int hysteresis = 32; // ADC counts above lowLevel before a trough counts as left
+  static const unsigned int trough_max = 48; // Scans, a trough at 40 Hz is well under 34
+
+  unsigned int channels;
+  bool rectified;
+  int yShift;
+  int lowLevel;
+  int sign;
+  bool low;
+  bool longTrough; // Overflowed the trough buffer - not a zero crossing, the sign flips when it ends
+
+  unsigned long n;
+  value_t firstU;
+  value_t previousU;
+  sample_t previous[max_channels];
+  sum_t sum[max_channels];
+  sum_t sumSquares[max_channels];
+  sum_t sumProducts[max_channels]; // Scaled by scanLength from the interpolation
+  value_t early[max_channels]; // Interpolation weights, scanLength - position and position
+  value_t late[max_channels];
+  unsigned int scanLength;
+
+  unsigned int troughLength;
+  sample_t trough[trough_max][max_channels];
+};
+
+#endif
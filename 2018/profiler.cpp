@@ -0,0 +1,116 @@
+/*
+
+  Stanford Engineers for a Sustainable World
+  Remote Monitoring System | August 2018
+
+  File: profiler.cpp
+  --------------------------
+  Implementation of profiler.h
+
+*/
+
+#include "application.h"
+#include "profiler.h"
+#include <time.h>
+
+// The host's micros() is the simulated board's clock, which the analysis takes none of, so stages are
+// timed in thread CPU time there
+static unsigned long stageClock() {
+    #ifdef PLATFORM_ID
+        return micros();
+    #else
+        timespec now;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+        return (unsigned long)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+    #endif
+}
+
+MeasurementProfiler::MeasurementProfiler() {
+    fits = 0;
+    begin();
+    clearTotals();
+}
+
+void MeasurementProfiler::begin() {
+    for(unsigned int s = 0; s < stage_count; s++) {
+        stageTime[s] = 0;
+        stageFits[s] = 0;
+    }
+    for(unsigned int i = 0; i < max_inputs; i++) {
+        residual[i] = 0;
+    }
+    attempts = 0;
+    warm = false;
+    stageStart = stageClock();
+    fitsAtStart = fits;
+}
+
+void MeasurementProfiler::startStage() {
+    stageStart = stageClock();
+    fitsAtStart = fits;
+}
+
+void MeasurementProfiler::endStage(Stage stage) {
+    stageTime[stage] += stageClock() - stageStart;
+    stageFits[stage] += fits - fitsAtStart;
+}
+
+void MeasurementProfiler::finish(unsigned int attempts, const double *residuals, unsigned int inputs) {
+    this->attempts = attempts;
+    for(unsigned int i = 0; i < inputs && i < max_inputs; i++) {
+        residual[i] = residuals[i];
+        if(residual[i] > maxResidual[i]) {
+            maxResidual[i] = residual[i];
+        }
+    }
+    for(unsigned int s = 0; s < stage_count; s++) {
+        totalFits[s] += stageFits[s];
+        totalTime[s] += stageTime[s];
+        if(stageTime[s] > maxTime[s]) {
+            maxTime[s] = stageTime[s];
+        }
+    }
+    totalAttempts += attempts;
+    warmCount += warm ? 1 : 0;
+    measurements++;
+}
+
+void MeasurementProfiler::clearTotals() {
+    measurements = 0;
+    totalAttempts = 0;
+    warmCount = 0;
+    for(unsigned int s = 0; s < stage_count; s++) {
+        totalFits[s] = 0;
+        totalTime[s] = 0;
+        maxTime[s] = 0;
+    }
+    for(unsigned int i = 0; i < max_inputs; i++) {
+        maxResidual[i] = 0;
+    }
+}
+
+uint32_t MeasurementProfiler::getTotalTime() const {
+    uint32_t total = 0;
+    for(unsigned int s = 0; s < stage_count; s++) {
+        total += stageTime[s];
+    }
+    return total;
+}
+
+bool MeasurementProfiler::appendSummary(PayloadWriter &out) const {
+    Payload<200> line;
+    line.appendf("P%u,%u,%u,%u", summary_version, measurements, totalAttempts, warmCount);
+    for(unsigned int s = 0; s < stage_count; s++) {
+        line.appendf(",%lu", (unsigned long)totalFits[s]);
+    }
+    for(unsigned int s = 0; s < stage_count; s++) {
+        line.appendf(",%lu", (unsigned long)getMeanStageTime((Stage)s));
+    }
+    for(unsigned int s = 0; s < stage_count; s++) {
+        line.appendf(",%lu", (unsigned long)maxTime[s]);
+    }
+    for(unsigned int i = 0; i < max_inputs; i++) {
+        line.appendf(",%.0f", maxResidual[i]);
+    }
+    return !line.overflowed() && out.append(line.c_str());
+}
@@ -0,0 +1,80 @@
+/*
+
+  Stanford Engineers for a Sustainable World
+  Remote Monitoring System | August 2018
+
+  File: profiler.h
+  --------------------------
+  Where a measurement's time goes, kept by Sensors as it runs so it can be read back or published
+  without a serial cable. Each stage is timed with micros() and counts the least-squares fits it solved,
+  and each measurement records the attempts it took, whether the warm start placed the period and the
+  residual of every input. A dozen micros() calls a measurement is all it costs, unlike the
+  VERBOSE/SHOWSTEPS prints that slow the loops they describe. Host builds time in thread CPU time.
+
+  Totals gather measurements until clearTotals(), appendSummary() writes them as one line:
+    P1,<measurements>,<attempts>,<warm>,<fits per stage>,<mean us per stage>,<max us per stage>,<max residual per input>
+  stages in Stage order, fields comma separated, under 200 characters.
+
+*/
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+#include "payload.h"
+
+class MeasurementProfiler {
+public:
+  enum Stage { record, smooth, spectrum, frequency, amplitude, power, stage_count };
+  static const unsigned int max_inputs = 4;
+
+/**********************************  SETUP  ***********************************/
+  MeasurementProfiler();
+
+/********************************  FUNCTIONS  *********************************/
+  void    begin(); // Start of a measurement, clears the last one
+  void    startStage();
+  void    endStage(Stage stage); // Adds the time and fits since startStage()
+  void    countFit() { fits++; }
+  void    countWarm() { warm = true; }
+  void    finish(unsigned int attempts, const double *residuals, unsigned int inputs); // Adds the measurement to the totals
+  void    clearTotals();
+  bool    appendSummary(PayloadWriter &out) const; // False if it did not fit
+
+  // Last measurement
+  uint32_t  getStageTime(Stage stage) const { return stageTime[stage]; } // us, all attempts
+  uint32_t  getStageFits(Stage stage) const { return stageFits[stage]; }
+  uint32_t  getTotalTime() const; // us
+  unsigned int  getAttempts() const { return attempts; }
+  bool    wasWarm() const { return warm; }
+  double  getResidual(unsigned int input) const { return input < max_inputs ? residual[input] : 0; }
+
+  // Since clearTotals()
+  unsigned int  getMeasurements() const { return measurements; }
+  uint32_t  getMeanStageTime(Stage stage) const { return measurements ? totalTime[stage] / measurements : 0; }
+  uint32_t  getMaxStageTime(Stage stage) const { return maxTime[stage]; }
+
+private:
+/*********************************  OBJECTS  **********************************/
+  static const unsigned int summary_version = 1;
+
+  unsigned long stageStart; // micros()
+  uint32_t fitsAtStart;
+  uint32_t fits;
+
+  uint32_t stageTime[stage_count];
+  uint32_t stageFits[stage_count];
+  unsigned int attempts;
+  bool warm;
+  float residual[max_inputs];
+
+  unsigned int measurements;
+  unsigned int totalAttempts;
+  unsigned int warmCount;
+  uint32_t totalFits[stage_count];
+  uint32_t totalTime[stage_count]; // us, wraps after an hour of analysis
+  uint32_t maxTime[stage_count];
+  float maxResidual[max_inputs];
+};
+
+#endif
@@ -0,0 +1,47 @@
+/*
+
+  Stanford Engineers for a Sustainable World
+  Remote Monitoring System | August 2018
+
+  File: sample.h
+  --------------------------
+  Storage type for captured ADC readings. Readings are 12-bit, so the default uint16_t holds them exactly
+  at a quarter of the RAM a double takes. Define SAMPLE_TYPE to build with another type.
+  SampleTraits gives the analysis kernels the types to do their per-sample arithmetic in, so integer
+  samples are offset, compared and squared in integer registers.
+
+*/
+
+#ifndef SAMPLE_H
+#define SAMPLE_H
+
+#include <stdint.h>
+
+#ifndef SAMPLE_TYPE
+  #define SAMPLE_TYPE uint16_t
+#endif
+
+typedef SAMPLE_TYPE sample_t;
+
+static const int adc_max = 4095;
+
+// Floating point samples
+template <typename T> struct SampleTraits {
+  typedef double value_t; // A sample less its offset
+  typedef double sum_t; // Sums of values and of squared values
+  static T fromDouble(double v) { return v < 0 ? 0 : (v > adc_max ? adc_max : v); }
+};
+
+template <> struct SampleTraits<uint16_t> {
+  typedef int32_t value_t;
+  typedef int64_t sum_t;
+  static uint16_t fromDouble(double v) { return v < 0 ? 0 : (v > adc_max ? adc_max : (uint16_t)(v + .5)); }
+};
+
+template <> struct SampleTraits<int16_t> {
+  typedef int32_t value_t;
+  typedef int64_t sum_t;
+  static int16_t fromDouble(double v) { return v < 0 ? 0 : (v > adc_max ? adc_max : (int16_t)(v + .5)); }
+};
+
+#endif
@@ -0,0 +1,95 @@
+/*
+
+  Stanford Engineers for a Sustainable World
+  Remote Monitoring System | August 2018
+
+  File: scheduler.cpp
+  --------------------------
+  Implementation of scheduler.h
+
+*/
+#include "application.h"
+#include "scheduler.h"
+
+Scheduler::Scheduler() {
+    count = 0;
+    last = -1;
+    busy = 0;
+}
+
+int Scheduler::add(Task task, void *context, unsigned char priority, unsigned long delay) {
+    if(count == max_tasks) {
+        return -1;
+    }
+    Entry &entry = tasks[count];
+    entry.task = task;
+    entry.context = context;
+    entry.priority = priority;
+    entry.scheduled = delay != never;
+    entry.due = millis() + delay;
+    return count++;
+}
+
+void Scheduler::wake(int id, unsigned long delay) {
+    if(id < 0 || id >= (int)count) {
+        return;
+    }
+    Entry &entry = tasks[id];
+    unsigned long due = millis() + delay;
+    // Deadlines compare as differences so millis() may wrap
+    if(!entry.scheduled || (long)(due - entry.due) < 0) {
+        entry.due = due;
+        entry.scheduled = true;
+    }
+}
+
+bool Scheduler::runNext() {
+    unsigned long now = millis();
+    int next = -1;
+    for(unsigned int i = 0; i < count; i++) {
+        const Entry &entry = tasks[i];
+        if(!entry.scheduled || (long)(now - entry.due) < 0) {
+            continue;
+        }
+        if(next < 0 || entry.priority > tasks[next].priority ||
+            (entry.priority == tasks[next].priority && (long)(entry.due - tasks[next].due) < 0)) {
+            next = i;
+        }
+    }
+    if(next < 0) {
+        return false;
+    }
+    Entry &entry = tasks[next];
+    entry.scheduled = false; // The task may wake itself while it runs
+    last = next;
+    unsigned long start = micros();
+    unsigned long delay = entry.task(entry.context);
+    busy = micros() - start;
+    if(delay != never) {
+        wake(next, delay);
+    }
+    return true;
+}
+
+unsigned long Scheduler::untilNext() {
+    unsigned long now = millis();
+    unsigned long soonest = never;
+    for(unsigned int i = 0; i < count; i++) {
+        if(tasks[i].scheduled) {
+            long left = (long)(tasks[i].due - now);
+            unsigned long wait = left > 0 ? left : 0;
+            if(wait < soonest) {
+                soonest = wait;
+            }
+        }
+    }
+    return soonest;
+}
+
+int Scheduler::lastTask() {
+    return last;
+}
+
+unsigned long Scheduler::lastBusy() {
+    return busy;
+}
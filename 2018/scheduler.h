@@ -0,0 +1,52 @@
+/*
+
+  Stanford Engineers for a Sustainable World
+  Remote Monitoring System | August 2018
+
+  File: scheduler.h
+  --------------------------
+  Cooperative scheduler for the main loop. A task is a function that does one step of work and
+  returns how many milliseconds until it wants to run again, so periodic jobs and state machines
+  (cellular sessions) are written the same way and never block each other with delay().
+  When several tasks are due the highest priority runs first, one task per runNext().
+
+*/
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+class Scheduler {
+public:
+  typedef unsigned long (*Task)(void *context); // One step, returns ms until the next one or Scheduler::never
+
+/**********************************  SETUP  ***********************************/
+  Scheduler();
+
+/********************************  FUNCTIONS  *********************************/
+  int     add(Task task, void *context, unsigned char priority, unsigned long delay); // Returns the task's id, -1 if full
+  void    wake(int id, unsigned long delay = 0); // Runs the task within delay ms, sooner if it was already due sooner
+  bool    runNext(); // Runs the most urgent due task, false if none was due
+  unsigned long untilNext(); // ms until the next deadline, never if no task is scheduled
+  int     lastTask(); // Id of the task the last runNext() ran, -1 before the first
+  unsigned long lastBusy(); // us that step took
+
+  static const unsigned long never = 0xFFFFFFFF;
+  static const unsigned int max_tasks = 8;
+
+private:
+/*********************************  OBJECTS  **********************************/
+  struct Entry {
+    Task          task;
+    void *        context; // Passed to task, e.g. the object it is a step of
+    unsigned char priority;
+    bool          scheduled;
+    unsigned long due; // millis()
+  };
+
+  Entry tasks[max_tasks];
+  unsigned int count;
+  int last;
+  unsigned long busy;
+};
+
+#endif
@@ -11,67 +11,93 @@
 */
 #include "application.h"
 #include <cmath>
+#include <type_traits>
 #include "sensors.h"
+#include "generator_monitor.h"
 #include <stdlib.h>
 
-Sensors::Sensors() {
+// Calls f.apply<Index>() for every input F::selects(), unrolled at compile time. Inputs it does not
+// select are never instantiated, so their branches and reads do not exist in the build.
+template <unsigned int Index, unsigned int Count = site_input_count> struct EachInput {
+    template <typename F> static inline void run(F &f) {
+        apply(f, std::integral_constant<bool, F::selects(Index)>());
+        EachInput<Index + 1, Count>::run(f);
+    }
+    template <typename F> static inline void apply(F &f, std::true_type) { f.template apply<Index>(); }
+    template <typename F> static inline void apply(F &, std::false_type) {}
+};
+
+template <unsigned int Count> struct EachInput<Count, Count> {
+    template <typename F> static inline void run(F &) {}
+};
+
+// One scan of every recorded input
+struct Sensors::ScanKernel {
+    static constexpr bool selects(unsigned int index) { return isRecorded(index); }
+    template <unsigned int Index> void apply() {
+        scan[Index] = sensors.samples[Index][i] = analogRead(site_channels[Index].pin);
+        sensors.input[Index].smoothing.add(scan[Index]);
+    }
+
+    Sensors &sensors;
+    sample_t *scan;
+    unsigned int i;
+};
+
+// One scan of every recorded input out of a block, inputs at their place in the scan
+struct Sensors::BlockKernel {
+    static constexpr bool selects(unsigned int index) { return isRecorded(index); }
+    template <unsigned int Index> void apply() {
+        scan[Index] = sensors.samples[Index][i] = block[scanPosition(Index)];
+        sensors.input[Index].smoothing.add(scan[Index]);
+    }
 
+    Sensors &sensors;
+    sample_t *scan;
+    const uint16_t *block;
+    unsigned int i;
+};
+
+static_assert(scan_length <= Acquisition::max_channels, "More recorded inputs than Acquisition can scan");
+static_assert(site_input_count <= MeasurementProfiler::max_inputs, "More inputs than MeasurementProfiler keeps residuals for");
+static_assert(!FIXED_POINT || MEASUREMENT_SAMPLES <= Spectrum::fixed_max_samples, "MEASUREMENT_SAMPLES could overflow the fixed-point spectrum");
+
+// One sample of every active input against the model basis, rectified inputs against its double angle
+struct Sensors::FitKernel {
+    static constexpr bool selects(unsigned int index) { return !site_channels[index].ignore; }
+    template <unsigned int Index> void apply() {
+        addFitSample<isMasked(Index)>(site_channels[Index], sensors.samples[Index][j],
+            site_channels[Index].rectified ? c2 : c, site_channels[Index].rectified ? s2 : s, sums[Index]);
+    }
+
+    Sensors &sensors;
+    FitSums *sums;
+    int j;
+    basis_t c;
+    basis_t s;
+    basis_t c2;
+    basis_t s2;
+};
+
+Sensors::Sensors() {
+    measurementDuration = scan_interval;
+    sampleCount = measurement_samples;
+    channelDelay = 0;
 }
 
 void Sensors::init() {
 
+    int pins[Acquisition::max_channels];
     for(unsigned int i = 0; i < input_count; i++) {
-        pinMode(input[i].pin, INPUT);
+        if(isRecorded(i)) {
+            pinMode(site_channels[i].pin, INPUT);
+            pins[scanPosition(i)] = site_channels[i].pin;
+        }
     }
+    acquisition.begin(pins, scan_length, scan_interval);
     #ifdef MEASUREFLASH
         led.setActive();
     #endif
-    input[0].pin = A0;
-    input[0].yShift = -321;
-    input[0].waveMin = 550;
-    input[0].waveMax = 4096;
-    input[0].a = 0; 
-    input[0].b = .0015422152;
-    input[0].c = 16.52494;
-    input[0].rectified = true;
-    input[0].ignore = true;
-    input[0].maxError = 5000;
-
-    // Current 1
-    input[1].pin = A1;
-    input[1].yShift = 1975;
-    input[1].waveMin = -1;
-    input[1].waveMax = 4096;
-    input[1].a = 0;
-    input[1].b = 1;
-    input[1].c = 0;
-    input[1].rectified = false;
-    input[1].ignore = true;
-    input[1].maxError = 5000;
-
-    // Current 2
-    input[2].pin = A2;
-    input[2].yShift = 1975;
-    input[2].waveMin = -1;
-    input[2].waveMax = 4096;
-    input[2].a = 0;
-    input[2].b = 1;
-    input[2].c = 0;
-    input[2].rectified = false;
-    input[2].ignore = true;
-    input[2].maxError = 5000;
-
-    // Current 3
-    input[3].pin = A3;
-    input[3].yShift = 1975;
-    input[3].waveMin = -1;
-    input[3].waveMax = 4096;
-    input[3].a = 0;
-    input[3].b = 1;
-    input[3].c = 0;
-    input[3].rectified = false;
-    input[3].ignore = true;
-    input[3].maxError = 5000;
 
 }
 
@@ -82,24 +108,40 @@ void Sensors::refreshAll() {
             delay(1000);
         }
     #endif
-    for(int attempts = 0; attempts < maxMeasurementAttempts; attempts++) {
+    bool generatorOn = false;
+    int attempts = 0;
+    profiler.begin();
+    while(attempts < maxMeasurementAttempts) {
+        attempts++;
         #ifdef VERBOSE
             Serial.println("------------------");
-            Serial.println(String::format("MEASUREMENT ATTEMPT %d", attempts+1));
+            Serial.println(String::format("MEASUREMENT ATTEMPT %d", attempts));
         #endif
         
         #ifdef MEASUREFLASH
             led.on();
         #endif
+        profiler.startStage();
         recordSamples();
+        profiler.endStage(MeasurementProfiler::record);
         #ifdef MEASUREFLASH
             led.off();
         #endif
 
-        if(checkStatus()) {
+        generatorOn = checkStatus(sampleCount);
+        if(generatorOn) {
+            profiler.startStage();
             analyzeSmoothedWaves();
+            profiler.endStage(MeasurementProfiler::smooth);
+            profiler.startStage();
+            analyzeSpectrum();
+            profiler.endStage(MeasurementProfiler::spectrum);
+            profiler.startStage();
             bruteforceFrequencies();
+            profiler.endStage(MeasurementProfiler::frequency);
+            profiler.startStage();
             bruteforceAmplitudes();
+            profiler.endStage(MeasurementProfiler::amplitude);
         } else {
             zeroMeasurements(); // Set currents to 0 if generator is off
         }
@@ -109,11 +151,64 @@ void Sensors::refreshAll() {
         }
     }
     
-    if(measurementsValid) {
+    if(measurementsValid && generatorOn) {
         #ifndef IGNOREPOWER
+            profiler.startStage();
             calculatePower();
+            profiler.endStage(MeasurementProfiler::power);
         #endif
+    }
+    compressMeasurements();
+    finishProfile(attempts);
+}
+
+// One capture and no wave fitting - RMS values are true RMS and the frequency comes from the voltage's
+// crossings, or its spectrum if it had none
+void Sensors::refreshPower() {
+    profiler.begin();
+    #ifdef MEASUREFLASH
+        led.on();
+    #endif
+    profiler.startStage();
+    recordSamples();
+    profiler.endStage(MeasurementProfiler::record);
+    #ifdef MEASUREFLASH
+        led.off();
+    #endif
+
+    if(checkStatus(sampleCount)) {
+        profiler.startStage();
+        calculatePower();
+        profiler.endStage(MeasurementProfiler::power);
+        for(unsigned int i = 0; i < input_count; i++) {
+            input[i].rms = input[i].trueRms;
+        }
+        if(tracker.isValid()) {
+            d_frequency = tracker.getMeanFrequency();
+        } else {
+            profiler.startStage();
+            analyzeSpectrum();
+            profiler.endStage(MeasurementProfiler::spectrum);
+            d_frequency = input[0].spectrum.isValid() ? input[0].spectrum.getFundamental() : 0;
+        }
+        measurementsValid = true;
+    } else {
+        zeroMeasurements();
+    }
+    compressMeasurements();
+    finishProfile(1);
+}
 
+void Sensors::finishProfile(unsigned int attempts) {
+    double residuals[input_count];
+    for(unsigned int i = 0; i < input_count; i++) {
+        residuals[i] = site_channels[i].ignore ? 0 : input[i].error;
+    }
+    profiler.finish(attempts, residuals, input_count);
+}
+
+void Sensors::compressMeasurements() {
+    if(measurementsValid) {
         #ifdef SHOWSTEPS
             Serial.println("---------FINAL ERROR---------");
             Serial.println(String::format("Voltage Error - %f", input[0].error));
@@ -136,7 +231,9 @@ void Sensors::refreshAll() {
         current_1 = input[1].rms*compressionMultiplier;
         current_2 = input[2].rms*compressionMultiplier;
         current_3 = input[3].rms*compressionMultiplier;
-        power = power*compressionMultiplier;
+        if(power != invalidPlaceholder) {
+            power = power*compressionMultiplier;
+        }
 
         #ifdef VERBOSE
             Serial.println("---------FINAL OUTPUT---------");
@@ -167,10 +264,12 @@ void Sensors::refreshAll() {
 }
 
   void Sensors::refreshStatus() {
+    claimADC();
     for(unsigned int i = 0; i < status_samples; i++) {
-      samples[0][i] = analogRead(input[0].pin);
+      samples[0][i] = analogRead(site_channels[0].pin);
     }
-    inputActive = checkStatus();
+    releaseADC();
+    inputActive = checkStatus(status_samples);
   }
 
   void Sensors::fieldTest() {
@@ -183,6 +282,12 @@ void Sensors::refreshAll() {
     return inputActive;
   }
 
+  // A rectified voltage's troughs and a stopped generator both read near 0 on a real ADC, so the level
+  // is never below the voltage's waveMin
+  int Sensors::getStatusLevel() {
+    return site_channels[0].waveMin > site_channels[0].yShift + inputActiveThreshold ? site_channels[0].waveMin : site_channels[0].yShift + inputActiveThreshold;
+  }
+
   unsigned short Sensors::getVoltage() {
     return voltage;
   }
@@ -207,30 +312,153 @@ void Sensors::refreshAll() {
     return (unsigned short)power;
   }
 
-  double Sensors::waveError(int measurementIndex, int iterator, int xShift, int amplitude) {
-    return pow((samples[measurementIndex][iterator] - simulateWave(input[measurementIndex].yShift, input[measurementIndex].rectified, xShift, amplitude, iterator)), 2);
+  double Sensors::getHarmonic(unsigned int index, unsigned int harmonic) {
+    return index < input_count ? input[index].spectrum.getHarmonic(harmonic) : 0;
   }
 
-  double Sensors::simulateWave(int yShift, bool rectified, int xShift, int amplitude, int iterator) {
-    if(rectified) {
-      return ((double)yShift + ((double)amplitude/(double)100) * fabs(cos( 2.0 * pi *  (((double)xShift/(double)xShiftRangeMax) + (((double)iterator*measurementDuration) / (double)period)))));
-    } else {
-      return ((double)yShift + ((double)amplitude/(double)100) * cos( 2.0 * pi *  (((double)xShift/(double)xShiftRangeMax) + (((double)iterator*measurementDuration) / (double)period))));
+  double Sensors::getRealPower(unsigned int phase) {
+    return phase > 0 && phase < input_count ? input[phase].realPower : 0;
+  }
+
+  double Sensors::getApparentPower(unsigned int phase) {
+    return phase > 0 && phase < input_count ? input[phase].apparentPower : 0;
+  }
+
+  double Sensors::getReactivePower(unsigned int phase) {
+    return phase > 0 && phase < input_count ? input[phase].reactivePower : 0;
+  }
+
+  double Sensors::getPowerFactor(unsigned int phase) {
+    return phase > 0 && phase < input_count ? input[phase].powerFactor : 0;
+  }
+
+  unsigned int Sensors::getCycleCount() {
+    return tracker.getCycleCount();
+  }
+
+  double Sensors::getCycleFrequency(unsigned int cycle) {
+    return tracker.getCycleFrequency(cycle);
+  }
+
+  double Sensors::getMinFrequency() {
+    return tracker.getMinFrequency();
+  }
+
+  double Sensors::getMaxFrequency() {
+    return tracker.getMaxFrequency();
+  }
+
+  double Sensors::getMeanFrequency() {
+    return tracker.getMeanFrequency();
+  }
+
+  double Sensors::getROCOF() {
+    return tracker.getROCOF();
+  }
+
+  bool Sensors::isROCOFValid() {
+    return tracker.isROCOFValid();
+  }
+
+  unsigned int Sensors::getConfidence() {
+    return warmStart.confidence;
+  }
+
+  MeasurementProfiler &Sensors::getProfiler() {
+    return profiler;
+  }
+
+  void Sensors::shareADC(GeneratorMonitor &monitor) {
+    this->monitor = &monitor;
+  }
+
+  // The monitor's Timer reads the ADC too, it would upset a DMA capture or a polled read it lands in
+  void Sensors::claimADC() {
+    monitorPaused = monitor && monitor->isRunning();
+    if(monitorPaused) {
+      monitor->pause();
+    }
+  }
+
+  void Sensors::releaseADC() {
+    if(monitorPaused) {
+      monitor->resume();
+      monitorPaused = false;
+    }
+  }
+
+  void Sensors::writeCapture(CaptureSink &out, uint32_t time) {
+    Capture capture = Capture();
+    capture.flags = (measurementsValid ? capture_valid : 0) | (checkStatus(sampleCount) ? capture_generator_on : 0) | (FIXED_POINT ? capture_fixed_point : 0);
+    capture.count = sampleCount;
+    capture.interval = measurementDuration;
+    capture.channelDelay = channelDelay;
+    capture.time = time;
+    capture.period = period;
+    for(unsigned int i = 0; i < input_count; i++) {
+      if(!isRecorded(i)) {
+        continue;
+      }
+      const ChannelConfig &in = site_channels[i];
+      CaptureChannel &c = capture.channel[capture.channels++];
+      c.input = i;
+      c.pin = in.pin;
+      c.flags = (in.rectified ? capture_rectified : 0) | (in.ignore ? capture_ignored : 0);
+      c.yShift = in.yShift;
+      c.waveMin = in.waveMin;
+      c.waveMax = in.waveMax;
+      c.a = in.a;
+      c.b = in.b;
+      c.c = in.c;
+      c.maxError = in.maxError;
+      c.amplitude = input[i].amplitude;
+      c.xShift = input[i].xShift;
+      c.error = input[i].error;
+      c.samples = samples[i];
     }
+    ::writeCapture(out, capture);
+  }
+
+  double Sensors::getTHD(unsigned int index) {
+    return index < input_count && input[index].spectrum.isValid() ? input[index].spectrum.getTHD() : -1;
+  }
+
+  WaveSynth Sensors::modelWave(unsigned int xShift) {
+    return WaveSynth(2.0 * pi * (double)xShift / (double)xShiftRangeMax, 2.0 * pi * measurementDuration / (double)period);
+  }
+
+  // A level sample sums 2^level samples, so it sits at the middle of them and steps 2^level samples
+  ModelSynth Sensors::modelBasis(unsigned int level) {
+    double step = 2.0 * pi * measurementDuration / (double)period;
+    return ModelSynth(step * ((1 << level) - 1) / 2.0, step * (1 << level));
+  }
+
+  double Sensors::simulateWave(const WaveSynth &wave, int yShift, bool rectified, int amplitude) {
+    return (double)yShift + ((double)amplitude/(double)100) * wave.wave(rectified);
   }
 
   void Sensors::recordSamples() {
 // Record samples and sampling time
+    pyramidInput = -1;
+    claimADC();
 #ifndef GENERATESAMPLES
-    int sampleTime = -micros();
-    for(unsigned int i = 0; i < measurement_samples; i++) {
-      for(unsigned int j = 0; j < input_count; j++) {
-        samples[j][i] = analogRead(input[j].pin);
-      }
+  #ifdef POLLED_ACQUISITION
+    capturePolled();
+  #else
+    // A capture the DMA stopped delivering is dropped and taken again with analogRead(). The next one
+    // tries the DMA again unless it failed max_timeouts captures in a row
+    if(acquisition.disabled() || !captureBlocks()) {
+      #ifdef VERBOSE
+        Serial.println("Acquisition timed out, capturing with analogRead()");
+      #endif
+      capturePolled();
     }
-    sampleTime += micros();
-    measurementDuration = ((double)sampleTime / (double)measurement_samples);
+  #endif
 #else
+    beginCapture();
+    sample_t scan[input_count] = {};
+    channelDelay = 0;
+    sampleCount = measurement_samples;
     measurementDuration = 160;
     srand(micros() % 1000000);
     for(int a = 0; a < 2; a++) { // The first iteration is to calibrate measurementDuration
@@ -254,9 +482,12 @@ void Sensors::refreshAll() {
           Serial.println("------------------");
         }
         int sampleTime = -micros();
-        for(unsigned int i = 0; i < measurement_samples; i++) {
-          for(unsigned int j = 0; j < input_count; j++) {
-            samples[j][i] = simulateWave(input[j].yShift, input[j].rectified, input[j].xShift, input[j].amplitude, i);
+        for(unsigned int j = 0; j < input_count; j++) {
+          WaveSynth wave = modelWave(input[j].xShift);
+          input[j].smoothing.reset();
+          for(unsigned int i = 0; i < measurement_samples; i++, wave.next()) {
+            samples[j][i] = SampleTraits<sample_t>::fromDouble(simulateWave(wave, site_channels[j].yShift, site_channels[j].rectified, input[j].amplitude));
+            input[j].smoothing.add(samples[j][i]);
           }
         }
         if(a < 1) {
@@ -264,38 +495,137 @@ void Sensors::refreshAll() {
           measurementDuration = ((double)sampleTime / (double)measurement_samples);
         }
     }
+    for(unsigned int i = 0; i < measurement_samples; i++) {
+      for(unsigned int j = 0; j < input_count; j++) {
+        scan[j] = samples[j][i];
+      }
+      accumulator.add(scan);
+      tracker.add(scan[0]);
+    }
+    accumulator.finish();
+    tracker.finish(measurementDuration);
 
 #endif
+    releaseADC();
 #ifdef VERBOSE
     Serial.println("------------------");
     Serial.println("Samples recorded");
 #endif
 }
 
+// Starts what a capture feeds over
+void Sensors::beginCapture() {
+    for(unsigned int j = 0; j < input_count; j++) {
+      input[j].smoothing.reset();
+    }
+    // Troughs of a rectified voltage are where its sign flips
+    int lowLevel = getStatusLevel();
+    accumulator.begin(input_count, site_channels[0].rectified, site_channels[0].yShift, lowLevel);
+    tracker.begin(site_channels[0].rectified ? lowLevel : site_channels[0].yShift, site_channels[0].rectified);
+}
+
+// The capture stops after window_cycles whole voltage cycles, re-estimated as each one ends
+void Sensors::capturePolled() {
+    beginCapture();
+    sample_t scan[input_count] = {};
+    unsigned int target = measurement_samples;
+    unsigned int cycles = 0;
+    for(unsigned int j = 1; j < input_count; j++) {
+        accumulator.setReadOrder(j, scanPosition(j), scan_length);
+    }
+    ScanKernel kernel = {*this, scan, 0};
+    int sampleTime = -micros();
+    for(unsigned int i = 0; i < target; i++) {
+      kernel.i = i;
+      EachInput<0>::run(kernel);
+      accumulator.add(scan);
+      tracker.add(scan[0]);
+      if(tracker.getCyclesSoFar() != cycles) {
+        cycles = tracker.getCyclesSoFar();
+        target = windowLength(i + 1);
+      }
+    }
+    accumulator.finish();
+    sampleTime += micros();
+    sampleCount = target;
+    measurementDuration = ((double)sampleTime / (double)sampleCount);
+    channelDelay = measurementDuration / scan_length;
+    tracker.finish(measurementDuration);
+}
+
+// Same window as capturePolled(), false if a block never came
+bool Sensors::captureBlocks() {
+    beginCapture();
+    sample_t scan[input_count] = {};
+    unsigned int target = measurement_samples;
+    unsigned int cycles = 0;
+    // Reads of a scan are only channelDelay apart, weighted in us of the scan interval
+    channelDelay = acquisition.getChannelDelay();
+    for(unsigned int j = 1; j < input_count; j++) {
+        accumulator.setReadOrder(j, (unsigned int)(scanPosition(j) * channelDelay + .5), scan_interval);
+    }
+    BlockKernel kernel = {*this, scan, 0, 0};
+    acquisition.start();
+    for(unsigned int i = 0; i < target; i++) {
+      if(i % Acquisition::block_scans == 0) {
+        kernel.block = acquisition.nextBlock();
+        if(!kernel.block) {
+          acquisition.stop();
+          return false;
+        }
+      } else {
+        kernel.block += scan_length;
+      }
+      kernel.i = i;
+      EachInput<0>::run(kernel);
+      accumulator.add(scan);
+      tracker.add(scan[0]);
+      if(tracker.getCyclesSoFar() != cycles) {
+        cycles = tracker.getCyclesSoFar();
+        target = windowLength(i + 1);
+      }
+    }
+    acquisition.stop();
+    sampleCount = target;
+    accumulator.finish();
+    measurementDuration = acquisition.getInterval();
+    tracker.finish(measurementDuration);
+    #ifdef VERBOSE
+      if(acquisition.overran()) {
+        Serial.println("Acquisition overran, blocks were overwritten before they were read");
+      }
+    #endif
+    return !acquisition.failed();
+}
+
+// window_cycles of the mean cycle so far, or as many whole cycles as fit. Never fewer than the samples
+// already captured, and the whole buffer until a cycle has been seen.
+unsigned int Sensors::windowLength(unsigned int captured) {
+    double cycle = tracker.getSamplesPerCycle();
+    if(window_cycles == 0 || cycle <= 0) {
+        return measurement_samples;
+    }
+    unsigned int cycles = window_cycles;
+    if(cycles * cycle > measurement_samples) {
+        cycles = measurement_samples / cycle;
+    }
+    unsigned int length = cycles * cycle + .5;
+    if(length > measurement_samples) {
+        length = measurement_samples;
+    }
+    return length < captured ? captured : length;
+}
+
+// The smoothed range is tracked while recording, this only turns it into a preliminary amplitude
 void Sensors::analyzeSmoothedWaves() {
     #ifdef SHOWSTEPS
     Serial.println("------------------");
     #endif
     for(unsigned int index = 0; index < input_count; index++) {
-        if(!input[index].ignore) {
-            double avg = 0;
-            for(unsigned int i = 0; i < smoothing_n; i++) {
-                avg += samples[index][i];
-            }
-            smoothed_wave[0] = avg/smoothing_n;
-            double max = smoothed_wave[0];
-            double min = smoothed_wave[0];
-            for(int i = 0, len = measurement_samples-smoothing_n; i < len; i++) {
-                avg -= samples[index][i];
-                avg += samples[index][i+smoothing_n];
-                smoothed_wave[i + 1] = avg/smoothing_n;
-                if(smoothed_wave[i + 1] > max) {
-                    max = smoothed_wave[i + 1];
-                } else if(smoothed_wave[i + 1] < min) {
-                    min = smoothed_wave[i + 1];
-                }
-            }
-            input[index].amplitude = input[index].rectified ? 100*(max-min) : 50*(max-min);
+        if(!site_channels[index].ignore && input[index].smoothing.isValid()) {
+            double max = input[index].smoothing.getMax();
+            double min = input[index].smoothing.getMin();
+            input[index].amplitude = site_channels[index].rectified ? 100*(max-min) : 50*(max-min);
             #ifdef SHOWSTEPS
                 Serial.println(String::format("%d - Preliminary amplitude: %d", index, input[index].amplitude));
             #endif
@@ -309,133 +639,134 @@ void Sensors::analyzeSmoothedWaves() {
      return;
 }
 
+// Each input's bank only covers warmBand around its last fundamental while the warm start holds. A peak
+// in the outer half of that band may be the edge of one outside it, so the full band is run instead.
+void Sensors::analyzeSpectrum() {
+    bool warm = isWarm();
+    for(unsigned int index = 0; index < input_count; index++) {
+        if(!site_channels[index].ignore) {
+            double last = warmStart.fundamental[index];
+            bool found = false;
+            if(warm && last > 0) {
+                found = input[index].spectrum.analyze(samples[index], sampleCount, measurementDuration,
+                    last - warmBand, last + warmBand, site_channels[index].rectified)
+                    && fabs(input[index].spectrum.getFundamental() - last) < warmBand / 2;
+            }
+            if(!found) {
+                input[index].spectrum.analyze(samples[index], sampleCount, measurementDuration,
+                    1000000. / periodRangeMax, 1000000. / periodRangeMin, site_channels[index].rectified);
+            }
+            #ifdef SHOWSTEPS
+                Serial.println(String::format("%d - Fundamental: %f Hz, THD: %f", index, input[index].spectrum.getFundamental(), input[index].spectrum.getTHD()));
+            #endif
+        }
+    }
+    #ifdef VERBOSE
+        Serial.println("------------------");
+        Serial.println("Spectral analysis complete");
+    #endif
+}
+
+// The period is searched on one reference input, all inputs see the same generator. While the warm start
+// holds trackPeriod() tries near the last period first.
 void Sensors::bruteforceFrequencies() {
     #ifdef SHOWSTEPS
         Serial.println("------------------");
     #endif
     
-    bool foundPeriod = false;
     period = 0;
     for(unsigned int index = 0; index < input_count; index++) {
+        input[index].xShift = invalidPlaceholder;
+    }
+    int index = referenceInput();
+    if(index >= 0) {
+        double error;
+        double lowestError = -1;
+        unsigned int xShift = 0;
+        unsigned int amplitude;
+        unsigned int bestxShift = 0;
         int bestPeriod = 0;
-        if(!input[index].ignore) {
-            double error;
-            double lowestError = -1;
-            int xShift = 0;
-            int iterator;
-            int sampleCap = measurement_samples;
-
-            for(int periodRound = 0; periodRound < 3; periodRound++) {
-                if(periodRound == 1) {
-                    sampleCap = period / measurementDuration;
-                } else if(periodRound == 2) {
-                    sampleCap = measurement_samples;
-                    foundPeriod = false;
-                }
-                bool foundxShift = false;
-                lowestError = -1;
-
-                int periodMax = periodRangeMax;
-                int periodMin = periodRangeMin;
-                int xShiftMax = xShiftRangeMax;
-                int xShiftMin = xShiftRangeMin;
-
-                while(!foundPeriod || !foundxShift) {
-                // Recalculate period
-                    if(periodRound != 1 && !foundPeriod) {
-                        iterator = (periodMax-periodMin) / regression_n;
-                        if(iterator < 1) {
-                            foundPeriod = true;
-                            iterator = 1;
-                        }
-
-                        for(int i = periodMin; i < periodMax; i+= iterator) {
-                            #ifdef SHOWREGRESSION
-                                Serial.println(String::format("%d - Trying period %d, xShift %d", index, i, xShift));
-                            #endif
-                            period = i;
-                            error = 0;
-                            for(int j = 0; j < sampleCap; j++) {
-                                if(samples[index][j] > input[index].waveMin && samples[index][j] < input[index].waveMax) {
-                                    error += waveError(index, j, xShift, input[index].amplitude);
-                                }
-                            }
-                            error = sqrt(error);
-                            #ifdef SHOWREGRESSION
-                                Serial.println(String::format("%d - Error %f", index, error));
-                            #endif
-                            if(error < lowestError || lowestError < 0) {
-                                lowestError = error;
-                                bestPeriod = i;
-                            }
-                        }
-                        period = bestPeriod;
-                        periodMin = period - iterator;
-                        periodMax = period + iterator;
-                        #ifdef SHOWREGRESSION
-                            Serial.println(String::format("%d - Period - %d", index, period));
-                        #endif
-                    }
-                    if(periodRound != 2) {
-                        // Recalculate xShift
-                        iterator = (xShiftMax-xShiftMin) / regression_n;
-                        if(iterator < 1) {
-                            foundxShift = true;
-                            iterator = 1;
-                        }
-                        for(int i = xShiftMin; i < xShiftMax; i+= iterator) {
-                            #ifdef SHOWREGRESSION
-                                Serial.println(String::format("%d - Trying period %d, xShift %d", index, period, i));
-                            #endif
-                            error = 0;
-                            for(int j = 0; j < sampleCap; j++) {
-                                if(samples[index][j] > input[index].waveMin && samples[index][j] < input[index].waveMax) {
-                                    error += waveError(index, j, i, input[index].amplitude);
-                                }
-                            }
-                            error = sqrt(error);
-                            #ifdef SHOWREGRESSION
-                                Serial.println(String::format("%d - Error %f", index, error));
-                            #endif
-                            if(error < lowestError || lowestError < 0) {
-                                lowestError = error;
-                                xShift = i;
-                            }
-                        }
-                        xShiftMax = xShift + iterator;
-                        xShiftMin = xShift - iterator;
-                        #ifdef SHOWREGRESSION
-                            Serial.println(String::format("%d - xShift - %d", index, xShift));
-                        #endif
-                    } else {
-                      foundxShift = true;
-                    }
-                }
-                #ifdef SHOWSTEPS
-                    if(periodRound == 2) {
-                        Serial.println(String::format("Period: %d", period));
-                    }
+        int iterator;
+        bool foundPeriod = false;
+
+        int periodMax = periodRangeMax;
+        int periodMin = periodRangeMin;
+        if(isWarm() && trackPeriod(index, lowestError, bestxShift)) {
+            foundPeriod = true;
+            profiler.countWarm();
+        } else if(input[index].spectrum.isValid()) {
+            // Only search around the spectral fundamental when there is one
+            double f = input[index].spectrum.getFundamental();
+            int center = 1000000. / f;
+            int margin = 1000000. * spectrumMargin / (f * f) + 1;
+            if(center - margin > periodMin) periodMin = center - margin;
+            if(center + margin < periodMax) periodMax = center + margin;
+            if(periodMin >= periodMax) {
+                periodMin = periodRangeMin;
+                periodMax = periodRangeMax;
+            }
+        }
+
+        if(!foundPeriod) {
+            buildPyramid(index);
+        }
+        while(!foundPeriod) {
+            iterator = (periodMax-periodMin) / regression_n;
+            if(iterator < 1) {
+                foundPeriod = true;
+                iterator = 1;
+            }
+            // Only score as many samples as the step can be trusted over - a period off by one step
+            // drifts phaseDriftLimit cycles by the end of the window
+            int sampleCap = phaseDriftLimit * (double)periodRangeMin * (double)periodRangeMin / ((double)iterator * measurementDuration);
+            if(sampleCap > (int)sampleCount || foundPeriod) {
+                sampleCap = sampleCount;
+            }
+            lowestError = -1;
+            // Coarse rounds only bracket the period, so they score the coarsest level of the pyramid
+            // that keeps pyramid_min samples. Rounds finer than pyramid_step_min score every sample.
+            unsigned int level = 0;
+            while(!foundPeriod && iterator >= pyramid_step_min && level < pyramid_levels && (sampleCap >> (level + 1)) >= (int)pyramid_min) {
+                level++;
+            }
+
+            for(int i = periodMin; i < periodMax; i+= iterator) {
+                period = i;
+                error = fitWave(index, sampleCap, xShift, amplitude, level);
+                #ifdef SHOWREGRESSION
+                    Serial.println(String::format("%d - Trying period %d, xShift %d, amplitude %d", index, i, xShift, amplitude));
+                    Serial.println(String::format("%d - Error %f", index, error));
                 #endif
-                if(periodRound == 0 && bestPeriod == 0) {
-                    break;
+                if(error >= 0 && (error < lowestError || lowestError < 0)) {
+                    lowestError = error;
+                    bestPeriod = i;
+                    bestxShift = xShift;
                 }
             }
-            input[index].error = lowestError;
-            #ifdef SHOWSTEPS
-                Serial.println(String::format("1.%d xShift: %d", index, xShift));
-                Serial.println(String::format("1.%d error: %f", index, input[index].error));
-            #endif
-            input[index].xShift = xShift;
-            if(period < 15002) {
-                d_frequency = 0;
-            } else {
-                d_frequency = (((double)1000 * (double)1000. / (double)period));
+            if(bestPeriod == 0) {
+                break;
             }
+            period = bestPeriod;
+            periodMin = period - iterator;
+            periodMax = period + iterator;
+            #ifdef SHOWREGRESSION
+                Serial.println(String::format("%d - Period - %d", index, period));
+            #endif
+        }
+        #ifdef SHOWSTEPS
+            Serial.println(String::format("Period: %d (input %d)", period, index));
+        #endif
+        input[index].error = lowestError;
+        #ifdef SHOWSTEPS
+            Serial.println(String::format("1.%d xShift: %d", index, bestxShift));
+            Serial.println(String::format("1.%d error: %f", index, input[index].error));
+        #endif
+        input[index].xShift = bestxShift;
+        if(period < 15002) {
+            d_frequency = 0;
         } else {
-            input[index].xShift = invalidPlaceholder;
+            d_frequency = (((double)1000 * (double)1000. / (double)period));
         }
-        
-        
     }
     #ifdef VERBOSE
         Serial.println("------------------");
@@ -445,6 +776,90 @@ void Sensors::bruteforceFrequencies() {
     return;
 }
 
+// Near its minimum the squared residual is a parabola in the period, so three fits warmPeriodStep apart
+// place the minimum and a last fit there gives the result. Takes a second step if the minimum was
+// outside the three. False if it is not within warmPeriodMargin of the last period or the fits fail.
+bool Sensors::trackPeriod(int index, double &lowestError, unsigned int &bestxShift) {
+    int center = warmStart.period;
+    unsigned int xShift;
+    unsigned int amplitude;
+    for(int step = 0; step < 2; step++) {
+        double e[3];
+        for(int k = 0; k < 3; k++) {
+            period = center + (k - 1) * warmPeriodStep;
+            double error = fitWave(index, sampleCount, xShift, amplitude);
+            if(error < 0) {
+                return false;
+            }
+            e[k] = error * error;
+        }
+        double curvature = e[0] - 2*e[1] + e[2];
+        if(curvature <= 0) {
+            return false;
+        }
+        double offset = .5 * (e[0] - e[2]) / curvature;
+        center += (int)floor(offset * warmPeriodStep + .5);
+        if(abs(center - (int)warmStart.period) > warmPeriodMargin) {
+            return false;
+        }
+        if(fabs(offset) <= 1) {
+            break;
+        }
+    }
+    period = center;
+    lowestError = fitWave(index, sampleCount, bestxShift, amplitude);
+    #ifdef SHOWREGRESSION
+        Serial.println(String::format("%d - Tracked period %d from %d", index, period, warmStart.period));
+    #endif
+    return lowestError >= 0;
+}
+
+// Warm once warmConfidenceMin measurements in a row converged near each other, recently
+bool Sensors::isWarm() {
+    return warmStart.confidence >= warmConfidenceMin && millis() - warmStart.when < warmTimeout;
+}
+
+void Sensors::updateWarmStart() {
+    if(!measurementsValid || period == 0) {
+        warmStart.confidence = 0;
+        return;
+    }
+    bool agrees = warmStart.confidence > 0 && abs((int)period - (int)warmStart.period) <= warmPeriodMargin
+        && millis() - warmStart.when < warmTimeout;
+    warmStart.confidence = agrees ? warmStart.confidence + 1 : 1;
+    warmStart.period = period;
+    warmStart.when = millis();
+    for(unsigned int index = 0; index < input_count; index++) {
+        bool valid = !site_channels[index].ignore && input[index].spectrum.isValid();
+        warmStart.fundamental[index] = valid ? input[index].spectrum.getFundamental() : 0;
+    }
+}
+
+// Active input whose fundamental carries the largest share of its RMS, i.e. the least noise and distortion.
+// A rectified wave's strongest line only carries 4/(3pi) of its RMS when clean, so it is scored against that.
+int Sensors::referenceInput() {
+    int reference = -1;
+    double bestShare = -1;
+    for(unsigned int index = 0; index < input_count; index++) {
+        if(!site_channels[index].ignore) {
+            double rms = accumulator.getRms(index);
+            double share = 0;
+            if(input[index].spectrum.isValid() && rms > 0) {
+                share = input[index].spectrum.getHarmonic(1) / (sqrt2 * rms);
+                if(site_channels[index].rectified) {
+                    share /= 4.0 / (3.0 * pi);
+                }
+            }
+            if(share > bestShare) {
+                bestShare = share;
+                reference = index;
+            }
+        }
+    }
+    return reference;
+}
+
+// Every input is fit at the shared period in one pass over the samples
 void Sensors::bruteforceAmplitudes() {
     #ifdef SHOWSTEPS
         Serial.println("------------------");
@@ -452,54 +867,23 @@ void Sensors::bruteforceAmplitudes() {
 
     measurementsValid = true;
 
+    FitSums sums[input_count];
+    accumulateFits(sampleCount, sums);
+
     for(unsigned int index = 0; index < input_count; index++) {
-        if(!input[index].ignore) {
-            double error;
-            double lowestError = -1;
-            int iterator;
-            int amplitude = 0;
-
-            bool foundAmplitude = false;
-
-            int amplitudeMin = amplitudeRangeMin;
-            int amplitudeMax = amplitudeRangeMax;
-
-            while(!foundAmplitude) {
-                // Recalculate amplitude
-                iterator = (amplitudeMax-amplitudeMin) / regression_n;
-                if(iterator < 100) {
-                  foundAmplitude = true;
-                  iterator = 100;
-                }
-                for(int i = amplitudeMin; i < amplitudeMax; i+= iterator) {
-                    #ifdef SHOWREGRESSION
-                        Serial.println(String::format("%d - Trying amplitude %d", index, i));
-                    #endif
-                    error = 0;
-                    for(unsigned int j = 0; j < measurement_samples; j++) {
-                        if(samples[index][j] > input[index].waveMin && samples[index][j] < input[index].waveMax) {
-                            error += waveError(index, j, input[index].xShift, i);
-                        }
-                    }
-                    error = sqrt(error);
-                    #ifdef SHOWREGRESSION
-                        Serial.println(String::format("%d - Error %f", index, error));
-                    #endif
-                    if(error < lowestError || lowestError < 0) {
-                        lowestError = error;
-                        amplitude = i;
-                    }
-                }
-                amplitudeMin = amplitude - iterator;
-                amplitudeMax = amplitude + iterator;
-            }
-            if(lowestError < input[index].error) {
-                input[index].error = lowestError;
+        if(!site_channels[index].ignore) {
+            unsigned int xShift;
+            unsigned int amplitude;
+            double error = solveFit(index, sampleCount, sums[index], xShift, amplitude);
+
+            if(error >= 0) {
+                input[index].error = error;
+                input[index].xShift = xShift;
                 input[index].amplitude = amplitude;
             }
-            input[index].rms = evaluatePolynomial(input[index].a, input[index].b, input[index].c, (double)input[index].amplitude);
+            input[index].rms = evaluatePolynomial(site_channels[index].a, site_channels[index].b, site_channels[index].c, (double)input[index].amplitude);
 
-            if(input[index].error > input[index].maxError) {
+            if(error < 0 || input[index].error > site_channels[index].maxError) {
                 measurementsValid = false;
                 #ifdef SHOWSTEPS
                     Serial.println(String::format("2.%d amplitude: %d", index, input[index].amplitude));
@@ -510,6 +894,7 @@ void Sensors::bruteforceAmplitudes() {
                     Serial.println("ATTEMPT FAILED");
                     tmp += input[index].error;
                 #endif
+                updateWarmStart(); // The retry searches the full ranges
                 return;
             }
             #ifdef SHOWSTEPS
@@ -525,46 +910,239 @@ void Sensors::bruteforceAmplitudes() {
         Serial.println("------------------");
         Serial.println("Wave analysis complete");
     #endif
+    updateWarmStart();
 
     return;
 }
 
-bool Sensors::checkStatus() {
-  for(unsigned int i = 0; i < status_samples; i++) {
-    if((int)samples[0][i] > inputActiveThreshold+input[0].yShift) {
+// Fits yShift + amplitude/100 * cos(2pi(xShift/xShiftRangeMax + t/period)) to the first sampleCap samples by least squares.
+// Plain waves are linear in a cos/sin basis, so one pass of sums and a 2x2 solve gives the answer directly.
+// Rectified waves are fit in two passes: the phase comes from the 2nd harmonic of |cos| (the 1st one |cos| has),
+// then the amplitude is the least-squares scale of |cos| at that phase.
+// Only samples inside (waveMin, waveMax) take part. Returns sqrt of the summed squared error, or -1 if the fit is degenerate.
+// Levels above 0 fit the pyramid of the input, sampleCap >> level sums of 2^level samples. Only the error
+// is comparable between candidates there, xShift and amplitude are those of the summed wave.
+double Sensors::fitWave(int index, int sampleCap, unsigned int &xShift, unsigned int &amplitude, unsigned int level) {
+    if(index != pyramidInput || isMasked(index)) {
+        level = 0; // A sum mixes samples inside and outside the mask
+    }
+    if(site_channels[index].rectified) {
+        return isMasked(index) ? fitKernel<true, true>(index, sampleCap, xShift, amplitude, level) : fitKernel<true, false>(index, sampleCap, xShift, amplitude, level);
+    }
+    return isMasked(index) ? fitKernel<false, true>(index, sampleCap, xShift, amplitude, level) : fitKernel<false, false>(index, sampleCap, xShift, amplitude, level);
+}
+
+// Each level sums pairs of the one below, the samples of the capture first. 8 12-bit samples still fit in 16 bits.
+void Sensors::buildPyramid(int index) {
+    pyramidInput = -1;
+    if(index < 0 || isMasked(index)) {
+        return;
+    }
+    const sample_t *below = samples[index];
+    unsigned int count = sampleCount;
+    for(unsigned int level = 1; level <= pyramid_levels; level++) {
+        sample_t *sums = (sample_t *)levelSamples(-1, level);
+        count /= 2;
+        for(unsigned int k = 0; k < count; k++) {
+            sums[k] = below[2*k] + below[2*k + 1];
+        }
+        below = sums;
+    }
+    pyramidInput = index;
+}
+
+const sample_t *Sensors::levelSamples(int index, unsigned int level) {
+    switch(level) {
+        case 0:  return samples[index];
+        case 1:  return pyramid;
+        case 2:  return pyramid + measurement_samples / 2;
+        default: return pyramid + measurement_samples / 2 + measurement_samples / 4;
+    }
+}
+
+template <bool Rectified, bool Masked>
+double Sensors::fitKernel(int index, int sampleCap, unsigned int &xShift, unsigned int &amplitude, unsigned int level) {
+    ChannelConfig in = site_channels[index];
+    in.yShift *= 1 << level; // A level sample sums 2^level samples. yShift can be negative, so no shift
+    const sample_t *x = levelSamples(index, level);
+    int count = sampleCap >> level;
+    FitSums sums = FitSums();
+    ModelSynth wave = modelBasis(level);
+    for(int j = 0; j < count; j++, wave.next()) {
+        if(Rectified) {
+            addFitSample<Masked>(in, x[j], basisProduct(wave.cos(), wave.cos()) - basisProduct(wave.sin(), wave.sin()), 2*basisProduct(wave.cos(), wave.sin()), sums);
+        } else {
+            addFitSample<Masked>(in, x[j], wave.cos(), wave.sin(), sums);
+        }
+    }
+    return solveFit(index, sampleCap, sums, xShift, amplitude, level);
+}
+
+// First pass sums of every active input against one walk of the model basis
+void Sensors::accumulateFits(int sampleCap, FitSums *sums) {
+    for(unsigned int index = 0; index < input_count; index++) {
+        sums[index] = FitSums();
+    }
+    FitKernel kernel = {*this, sums, 0, 0, 0, 0, 0};
+    ModelSynth wave = modelBasis();
+    for(int j = 0; j < sampleCap; j++, wave.next()) {
+        kernel.j = j;
+        kernel.c = wave.cos();
+        kernel.s = wave.sin();
+        kernel.c2 = basisProduct(kernel.c, kernel.c) - basisProduct(kernel.s, kernel.s); // Double angle for rectified inputs
+        kernel.s2 = 2*basisProduct(kernel.c, kernel.s);
+        EachInput<0>::run(kernel);
+    }
+}
+
+template <bool Masked>
+void Sensors::addFitSample(const ChannelConfig &in, sample_t x, basis_t c, basis_t s, FitSums &f) {
+    if(!Masked || (x > in.waveMin && x < in.waveMax)) {
+        SampleTraits<sample_t>::value_t y = x - in.yShift;
+        f.n++;
+        f.sc += c;
+        f.ss += s;
+        f.scc += (basis_sum_t)c*c;
+        f.sss += (basis_sum_t)s*s;
+        f.scs += (basis_sum_t)c*s;
+        f.sy += y;
+        f.syc += (basis_sum_t)y*c;
+        f.sys += (basis_sum_t)y*s;
+        f.syy += (SampleTraits<sample_t>::sum_t)y*y;
+    }
+}
+
+double Sensors::solveFit(int index, int sampleCap, const FitSums &f, unsigned int &xShift, unsigned int &amplitude, unsigned int level) {
+    profiler.countFit();
+    const ChannelConfig &in = site_channels[index];
+    double phase;
+    double amp;
+    double error;
+
+    // Sums back to plain numbers, the only floating point a fit does
+    const double unit = 1 / basis_one;
+    const double n = f.n, sc = f.sc * unit, ss = f.ss * unit;
+    const double scc = f.scc * unit * unit, sss = f.sss * unit * unit, scs = f.scs * unit * unit;
+    const double syc = f.syc * unit, sys = f.sys * unit, sy = f.sy, syy = f.syy;
+
+    if(!in.rectified) {
+        double det = scc*sss - scs*scs;
+        if(det <= 1e-9 * scc * sss || det == 0) {
+            return -1;
+        }
+        double ca = (syc*sss - sys*scs) / det;
+        double sa = (sys*scc - syc*scs) / det;
+        amp = sqrt(ca*ca + sa*sa);
+        phase = atan2(-sa, ca);
+        error = syy - (ca*syc + sa*sys);
+    } else {
+        // Pass 1 was y = k0 + k1 cos(2t) + k2 sin(2t) - remove the constant term and solve the remaining 2x2 system
+        if(f.n < 3) {
+            return -1;
+        }
+        double mcc = scc - sc*sc/n, mss = sss - ss*ss/n, mcs = scs - sc*ss/n;
+        double myc = syc - sy*sc/n, mys = sys - sy*ss/n;
+        double det = mcc*mss - mcs*mcs;
+        if(det <= 1e-9 * mcc * mss || det == 0) {
+            return -1;
+        }
+        double ca = (myc*mss - mys*mcs) / det;
+        double sa = (mys*mcc - myc*mcs) / det;
+        phase = atan2(-sa, ca) / 2.0;
+
+        // Pass 2: scale of |cos| at that phase
+        double sgg = 0, syg = 0;
+        if(isMasked(index)) {
+            scaleRectified<true>(index, sampleCap, phase, sgg, syg, level);
+        } else {
+            scaleRectified<false>(index, sampleCap, phase, sgg, syg, level);
+        }
+        if(sgg <= 0) {
+            return -1;
+        }
+        amp = syg / sgg;
+        error = syy - amp*syg;
+    }
+
+    double shift = phase / (2.0 * pi);
+    shift -= floor(shift);
+    xShift = (unsigned int)(shift * xShiftRangeMax + .5) % xShiftRangeMax;
+    amplitude = amp < 0 ? 0 : (unsigned int)(amp * 100 + .5);
+    return sqrt(error > 0 ? error : 0);
+}
+
+// Sums of |cos| at the given phase against itself and against the samples
+template <bool Masked>
+void Sensors::scaleRectified(int index, int sampleCap, double phase, double &sgg, double &syg, unsigned int level) {
+    const ChannelConfig &in = site_channels[index];
+    const sample_t *samples = levelSamples(index, level);
+    const int yShift = in.yShift * (1 << level);
+    ModelSynth wave(phase, 2.0 * pi * measurementDuration * (1 << level) / (double)period);
+    basis_sum_t gg = 0, yg = 0;
+    for(int j = 0; j < sampleCap >> level; j++, wave.next()) {
+        sample_t x = samples[j];
+        if(!Masked || (x > in.waveMin && x < in.waveMax)) {
+            SampleTraits<sample_t>::value_t y = x - yShift;
+            basis_t g = wave.wave(true);
+            gg += (basis_sum_t)g*g;
+            yg += (basis_sum_t)y*g;
+        }
+    }
+    sgg += gg / (basis_one * basis_one);
+    syg += yg / basis_one;
+}
+
+// A capture shorter than status_samples is only checked as far as it goes, past it are older samples
+bool Sensors::checkStatus(unsigned int count) {
+  unsigned int n = count < status_samples ? count : status_samples;
+  for(unsigned int i = 0; i < n; i++) {
+    if((int)samples[0][i] > getStatusLevel()) {
       return true;
     }
   }
   return false;
 }
 
+// Real, apparent and reactive power per phase from the sums kept while recording. Every current is
+// taken against the one voltage input. Calibration maps amplitudes, so RMS readings go in as sqrt(2)*RMS.
 void Sensors::calculatePower() {
     #ifdef SHOWSTEPS
         Serial.println("------------------");
     #endif
-    int currentxShift;
-    int voltagexShift;
-    int linePower; 
+    for(unsigned int i = 0; i < input_count; i++) {
+        if(!site_channels[i].ignore) {
+            input[i].trueRms = evaluatePolynomial(site_channels[i].a, site_channels[i].b, site_channels[i].c, sqrt2 * 100 * accumulator.getRms(i));
+        } else {
+            input[i].trueRms = invalidPlaceholder;
+        }
+    }
+
     power = 0;
-    for(int j = 1; j < 4; j++) {
-        if(!input[j].ignore) {
-            currentxShift = input[j].xShift % (xShiftRangeMax/4);
-            voltagexShift = input[0].xShift % (xShiftRangeMax/4);
-
-            if(currentxShift - voltagexShift > -20 && currentxShift - voltagexShift < 0) {
-                currentxShift = voltagexShift;
-            } else if(currentxShift - voltagexShift < -20) {
-                currentxShift += xShiftRangeMax/4;
-            }
-            linePower = (double)input[0].rms * (double)input[1].rms * cos(2*pi*(currentxShift - voltagexShift)/xShiftRangeMax);
-            power += linePower;
-            Serial.println(String::format("Line Power %d: %f", j, linePower));
+    for(unsigned int j = 1; j < input_count; j++) {
+        Measurement &phase = input[j];
+        if(!site_channels[j].ignore && !site_channels[0].ignore) {
+            phase.powerFactor = accumulator.getPowerFactor(j);
+            phase.apparentPower = input[0].trueRms * phase.trueRms;
+            phase.realPower = phase.apparentPower * phase.powerFactor;
+            double reactive = phase.apparentPower*phase.apparentPower - phase.realPower*phase.realPower;
+            phase.reactivePower = reactive > 0 ? sqrt(reactive) : 0;
+            power += phase.realPower;
+            #ifdef SHOWSTEPS
+                Serial.println(String::format("Line %d: P %f, S %f, Q %f, PF %f", j, phase.realPower, phase.apparentPower, phase.reactivePower, phase.powerFactor));
+            #endif
         } else {
-            power = invalidPlaceholder;
-            break;
+            phase.powerFactor = 0;
+            phase.apparentPower = 0;
+            phase.realPower = 0;
+            phase.reactivePower = 0;
         }
     }
-    Serial.println(String::format("Total Power: %f", power));
+    if(site_channels[0].ignore) {
+        power = invalidPlaceholder;
+    }
+    #ifdef SHOWSTEPS
+        Serial.println(String::format("Total Power: %f", power));
+    #endif
     #ifdef VERBOSE
         Serial.println("------------------");
         Serial.println("Power calculations complete");
@@ -572,17 +1150,25 @@ void Sensors::calculatePower() {
 }
 
 void Sensors::zeroMeasurements() {
-    for(int i = 0; i < 4; i++) {
-        if(!input[i].ignore) {
+    warmStart.confidence = 0; // The generator may come back at another speed
+    for(unsigned int i = 0; i < input_count; i++) {
+        if(!site_channels[i].ignore) {
             input[i].rms = 0;
             input[i].amplitude = 0;
             input[i].error = 0;
+            input[i].realPower = 0;
+            input[i].apparentPower = 0;
+            input[i].reactivePower = 0;
+            input[i].powerFactor = 0;
         } else {
             input[i].rms = invalidPlaceholder;
             input[i].amplitude = invalidPlaceholder;
             input[i].error = 0;
         }
     }
+    for(unsigned int i = 0; i < input_count; i++) {
+        input[i].spectrum = Spectrum();
+    }
     inputActive = false;
     measurementsValid = true;
     power = 0;
@@ -591,12 +1177,13 @@ void Sensors::zeroMeasurements() {
 }
 
 void Sensors::printWaves(int index, bool simulated) {
-    for(unsigned int i = 0; i < measurement_samples; i++) {
-        Serial.println(String::format("%d, %f", i*(int)measurementDuration, samples[index][i]));
+    for(unsigned int i = 0; i < sampleCount; i++) {
+        Serial.println(String::format("%d, %f", i*(int)measurementDuration, (double)samples[index][i]));
     }
     if(simulated) {
-        for(unsigned int i = 0; i < measurement_samples; i++) {
-            Serial.println(String::format("%d, %f", i*(int)measurementDuration, simulateWave(input[index].yShift, input[index].rectified, input[index].xShift, input[index].amplitude, i)));
+        WaveSynth wave = modelWave(input[index].xShift);
+        for(unsigned int i = 0; i < sampleCount; i++, wave.next()) {
+            Serial.println(String::format("%d, %f", i*(int)measurementDuration, simulateWave(wave, site_channels[index].yShift, site_channels[index].rectified, input[index].amplitude)));
         }
     }
 }
@@ -13,14 +13,38 @@
 #ifndef SENSORS_H
 #define SENSORS_H
 
+#include "sample.h"
+#include "site_config.h"
+#include "wavesynth.h"
+#include "fixed_point.h"
+#include "spectrum.h"
+#include "smoothing.h"
+#include "power.h"
+#include "frequency.h"
+#include "acquisition.h"
+#include "capture.h"
+#include "profiler.h"
+
+class GeneratorMonitor;
+
 //#define VERBOSE // Verbose
 //#define SHOWSTEPS // Prints calculations - DEBUG1 should be enabled
 //#define SHOWREGRESSION // Prints regression - DEBUG1&2 should be enabled
 //#define GENERATESAMPLES // Generates random sample data
 //#define MEASUREFLASH // Flashes during measurement
 //#define IGNOREPOWER // Take a guess
+//#define POLLED_ACQUISITION // Captures with analogRead() instead of the timer and DMA
+
+#ifndef MEASUREMENT_SAMPLES
+  #define MEASUREMENT_SAMPLES 2000 // 16 KB of uint16_t samples for 4 inputs
+#endif
+#ifndef WINDOW_CYCLES
+  #define WINDOW_CYCLES 16 // Whole voltage cycles per capture, 0 always takes MEASUREMENT_SAMPLES
+#endif
 
 class Sensors {
+  friend class SensorsBenchmark; // host/bench.cpp times the private stages
+  friend class CaptureReplay; // host/replay.cpp runs captures back through them
 public:
 /**********************************  SETUP  ***********************************/
   Sensors ();
@@ -29,40 +53,97 @@ public:
   void		init();
   void    refreshStatus();
   void    refreshAll();
+  void    refreshPower(); // True RMS and power from one capture, no wave fitting
   void    fieldTest();
   bool    generatorIsOn();
+  int     getStatusLevel(); // ADC counts the voltage goes above while the generator is on
   unsigned short    getVoltage();
   unsigned short    getFrequency();
   unsigned short    getCurrent_1();
   unsigned short    getCurrent_2();
   unsigned short    getCurrent_3();
   unsigned short    getPower();
+  double  getHarmonic(unsigned int index, unsigned int harmonic); // Peak ADC counts, 1 = fundamental
+  double  getTHD(unsigned int index); // -1 if unknown
+  double  getRealPower(unsigned int phase); // Phases are inputs 1-3
+  double  getApparentPower(unsigned int phase);
+  double  getReactivePower(unsigned int phase);
+  double  getPowerFactor(unsigned int phase);
+  unsigned int  getCycleCount(); // Voltage cycles in the last capture, at most FrequencyTracker::max_cycles
+  double  getCycleFrequency(unsigned int cycle); // Hz
+  double  getMinFrequency();
+  double  getMaxFrequency();
+  double  getMeanFrequency();
+  double  getROCOF(); // Hz/s
+  bool    isROCOFValid(); // Whether the capture resolves the ROCOF at all, see FrequencyTracker::rocof_resolution
+  unsigned int  getConfidence(); // Converged measurements in a row the next one starts from
+  void    writeCapture(CaptureSink &out, uint32_t time); // Samples and fits of the last measurement, see capture.h
+  MeasurementProfiler &  getProfiler(); // Stage times and fit counts, see profiler.h
+  void    shareADC(GeneratorMonitor &monitor); // A running monitor is paused while a capture or status check reads the ADC
   
 
 private:
 /*********************************  HELPERS  **********************************/
-
-  double 	simulateWave(int yShift, bool rectified, int xShift, int amplitude, int iterator);
-	double 	waveError(int measurementIndex, int iterator, int xShift, int amplitude);
+  struct Measurement;
+  struct FitSums;
+  struct ScanKernel;
+  struct BlockKernel;
+  struct FitKernel;
+
+  WaveSynth 	modelWave(unsigned int xShift); // Model phase at sample 0, stepping one sample per next()
+  ModelSynth 	modelBasis(unsigned int level = 0); // modelWave(0) in the arithmetic of the fits, at a pyramid level
+  double 	simulateWave(const WaveSynth &wave, int yShift, bool rectified, int amplitude);
+	double 	fitWave(int index, int sampleCap, unsigned int &xShift, unsigned int &amplitude, unsigned int level = 0); // Least-squares amplitude/phase at the current period, returns error
+	template <bool Rectified, bool Masked> double fitKernel(int index, int sampleCap, unsigned int &xShift, unsigned int &amplitude, unsigned int level);
+	void 		buildPyramid(int index);
+	const sample_t *	levelSamples(int index, unsigned int level);
+	int 		referenceInput(); // Input the period is searched on, -1 if none are active
+	bool 		trackPeriod(int index, double &lowestError, unsigned int &bestxShift); // Warm start period search
+	bool 		isWarm();
+	void 		updateWarmStart(); // After each measurement
+	void 		accumulateFits(int sampleCap, FitSums *sums); // First pass of every active input at once
+	template <bool Masked> static void addFitSample(const ChannelConfig &in, sample_t x, basis_t c, basis_t s, FitSums &f);
+	double 	solveFit(int index, int sampleCap, const FitSums &f, unsigned int &xShift, unsigned int &amplitude, unsigned int level = 0);
+	template <bool Masked> void scaleRectified(int index, int sampleCap, double phase, double &sgg, double &syg, unsigned int level);
 	void	 	recordSamples();
+  void    beginCapture();
+  void    capturePolled();
+  bool    captureBlocks(); // False if the DMA stopped delivering blocks, the capture is dropped
+	unsigned int 	windowLength(unsigned int captured); // Samples to capture given the cycles seen so far
 	void 		analyzeSmoothedWaves();
+	void 		analyzeSpectrum();
 	void 		bruteforceFrequencies();
 	void 		bruteforceAmplitudes();
   void    calculatePower();
-	bool 		checkStatus();
+	bool 		checkStatus(unsigned int count); // Any of the first count voltage samples, at most status_samples, above the status level
 	void 		zeroMeasurements();
+	void 		compressMeasurements(); // Results to the unsigned short outputs
+	void 		finishProfile(unsigned int attempts); // Adds the measurement to the profiler
+  void    claimADC(); // Around every capture and polled read
+  void    releaseADC();
   double    evaluatePolynomial(double a, double b, double c, double x);
 	void 		printWaves(int index, bool simulated); // -1 --> all, 0-3 --> specific wave, uses a switch for easy customization
 
 
 /*********************************  OBJECTS  **********************************/
 
-  struct Measurement {
-  	int 					pin;
+	static const unsigned int smoothing_n = 5; // Voltage wave mean smoothing bucket size
+
+  struct FitSums { // Least-squares sums of one input against the model basis, in basis units
+    unsigned long n;
+    basis_sum_t   sc;
+    basis_sum_t   ss;
+    basis_sum_t   scc;
+    basis_sum_t   sss;
+    basis_sum_t   scs;
+    basis_sum_t   syc;
+    basis_sum_t   sys;
+    SampleTraits<sample_t>::sum_t sy;
+    SampleTraits<sample_t>::sum_t syy;
+  };
+
+  struct Measurement { // Wiring and calibration are in site_config.h
   	double 				rms;
-  	double 				a;
-  	double 				b;
-  	double 				c;
   	double 				fa;
     double 				fb;
     double 				fc;
@@ -70,13 +151,14 @@ private:
   	unsigned int 	xShift;
   	unsigned int 	amplitude;
 
-  	int 					yShift;
-  	int 					waveMin;
-  	int 					waveMax;
   	double 				error;
-    bool          rectified;
-    bool          ignore;
-    double        maxError;
+    Spectrum      spectrum;
+    SmoothingWindow<smoothing_n> smoothing; // Fed by recordSamples()
+    double        trueRms;
+    double        realPower; // Current inputs only
+    double        apparentPower;
+    double        reactivePower;
+    double        powerFactor;
 };
 
 	unsigned short 	voltage;
@@ -96,18 +178,31 @@ private:
   #endif
 
 	static constexpr double 	pi = 3.1415926535; // pi
-	static const unsigned int measurement_samples = 2000; // Number of samples to take .73 seconds worth of data
+	static constexpr double 	sqrt2 = 1.4142135624;
+	static const unsigned int measurement_samples = MEASUREMENT_SAMPLES; // Number of samples to take, 2000 is .73 seconds worth of data
+	static const unsigned int window_cycles = WINDOW_CYCLES;
 	static const unsigned int status_samples = 600; // Quick check for status - takes ~.2 seconds
-	static const unsigned int input_count = 4;
-	double samples[input_count][measurement_samples]; // Must be global to work on Particle (sampling array)
+	static const unsigned int input_count = site_input_count;
+	static const unsigned int scan_interval = 365; // us between timed scans, 2000 samples is .73 seconds as when polled
+	sample_t samples[input_count][measurement_samples]; // Must be global to work on Particle (sampling array)
+	static const unsigned int pyramid_levels = 3; // Sums of 2, 4 and 8 samples
+	static const unsigned int pyramid_min = 32; // Fewest samples a level is fit over
+	static const int pyramid_step_min = 4; // us, rounds this fine place the last round's bracket from every sample
+	sample_t pyramid[measurement_samples / 2 + measurement_samples / 4 + measurement_samples / 8]; // Levels of the reference input, 2x first
+	int pyramidInput = -1;
 	static const int maxMeasurementAttempts = 3;
 	static const int invalidPlaceholder = 9999;
 	static constexpr double compressionMultiplier = 100;
 	static const int inputActiveThreshold = 100;
 	bool inputActive = false;
-	static const unsigned int smoothing_n = 5; // Voltage wave mean smoothing bucket size
-	double smoothed_wave[measurement_samples - smoothing_n + 1]; // Must be global to work on particle (smoothed voltage array)
 	static const unsigned int regression_n = 10; // Feature matching stride
+	static constexpr double phaseDriftLimit = .25; // Cycles a period search step may drift across its scoring window
+	static constexpr double spectrumMargin = .5; // Hz either side of the spectral fundamental the period search covers
+	static constexpr double warmBand = 2; // Hz either side of an input's last fundamental its spectrum covers
+	static const int warmPeriodMargin = 60; // us the period may move from the last one before the full search runs
+	static const int warmPeriodStep = 10; // us between the fits trackPeriod() places the minimum with
+	static const unsigned int warmConfidenceMin = 2; // Converged measurements in a row before they are trusted
+	static const unsigned long warmTimeout = 2*60*60*1000; // ms, older results are not used
 
 
   const unsigned int periodRangeMin = 15000;
@@ -119,8 +214,24 @@ private:
 
 
 	double measurementDuration;
+	unsigned int sampleCount; // Samples in the last capture, the analysis only looks at these
+	double channelDelay; // us between the reads of consecutive inputs in a scan
 	bool measurementsValid;
 	Measurement input[input_count];
+	PowerAccumulator accumulator; // Fed by recordSamples()
+	FrequencyTracker tracker; // Fed the voltage by recordSamples()
+	Acquisition acquisition;
+	MeasurementProfiler profiler;
+	GeneratorMonitor *monitor = nullptr;
+	bool monitorPaused = false;
+
+  struct WarmStart { // Last converged measurement, the next one starts its searches there
+    unsigned int  period; // us
+    double        fundamental[input_count]; // Hz, 0 if the input had no spectrum
+    unsigned int  confidence;
+    unsigned long when; // millis()
+  };
+  WarmStart warmStart = WarmStart();
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,78 @@
+/*
+
+  Stanford Engineers for a Sustainable World
+  Remote Monitoring System | August 2018
+
+  File: site_config.h
+  --------------------------
+  Per-site input wiring and calibration, fixed at compile time. Each site is one table and one build,
+  so the analysis kernels in sensors.cpp are instantiated for exactly the inputs a board has: ignored
+  inputs are never read or fit, and rectification and sample masking are decided by the compiler
+  instead of once per sample.
+
+  Pick a site by defining its SITE_ macro, the default is the Cinta Mekar board.
+
+*/
+
+#ifndef SITE_CONFIG_H
+#define SITE_CONFIG_H
+
+#include "application.h"
+#include "sample.h"
+
+//#define SITE_BENCH // Every input active, for the host benchmark
+
+struct ChannelConfig {
+  int     pin;
+  int     yShift;
+  int     waveMin; // Only samples inside (waveMin, waveMax) are fit
+  int     waveMax;
+  double  a; // Calibration polynomial, amplitude --> RMS
+  double  b;
+  double  c;
+  bool    rectified;
+  bool    ignore;
+  double  maxError;
+};
+
+#if defined(SITE_BENCH)
+
+constexpr ChannelConfig site_channels[] = {
+  {A0, -321, 550, 4096, 0, .0015422152, 16.52494, true, false, 5000}, // Voltage
+  {A1, 1975, -1, 4096, 0, 1, 0, false, false, 5000}, // Current 1
+  {A2, 1975, -1, 4096, 0, 1, 0, false, false, 5000}, // Current 2
+  {A3, 1975, -1, 4096, 0, 1, 0, false, false, 5000}  // Current 3
+};
+
+#else // Cinta Mekar
+
+constexpr ChannelConfig site_channels[] = {
+  {A0, -321, 550, 4096, 0, .0015422152, 16.52494, true, true, 5000}, // Voltage
+  {A1, 1975, -1, 4096, 0, 1, 0, false, true, 5000}, // Current 1
+  {A2, 1975, -1, 4096, 0, 1, 0, false, true, 5000}, // Current 2
+  {A3, 1975, -1, 4096, 0, 1, 0, false, true, 5000}  // Current 3
+};
+
+#endif
+
+constexpr unsigned int site_input_count = sizeof(site_channels) / sizeof(site_channels[0]);
+static_assert(site_input_count == 4, "The outputs, LogRecord and the wire format are a voltage and three currents, ignore an input instead of leaving it out");
+
+// The voltage is always recorded, the status check and frequency tracking run on it
+constexpr bool isRecorded(unsigned int index) {
+  return index == 0 || !site_channels[index].ignore;
+}
+
+// Whether the fit has to check samples against (waveMin, waveMax) at all
+constexpr bool isMasked(unsigned int index) {
+  return site_channels[index].waveMin >= 0 || site_channels[index].waveMax <= adc_max;
+}
+
+// Reads before this input's in a scan
+constexpr unsigned int scanPosition(unsigned int index) {
+  return index == 0 ? 0 : scanPosition(index - 1) + (isRecorded(index - 1) ? 1 : 0);
+}
+
+constexpr unsigned int scan_length = scanPosition(site_input_count);
+
+#endif
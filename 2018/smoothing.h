@@ -0,0 +1,70 @@
+/*
+
+  Stanford Engineers for a Sustainable World
+  Remote Monitoring System | August 2018
+
+  File: smoothing.h
+  --------------------------
+  Streaming N sample moving average that keeps the lowest and highest average seen. Readings are
+  added as they are captured, so the smoothed range is known the moment a capture finishes without
+  storing the smoothed wave. Sums are compared instead of averages, so nothing is divided per sample.
+
+*/
+
+#ifndef SMOOTHING_H
+#define SMOOTHING_H
+
+#include "sample.h"
+
+template <unsigned int N>
+class SmoothingWindow {
+public:
+/**********************************  SETUP  ***********************************/
+  SmoothingWindow() { reset(); }
+
+/********************************  FUNCTIONS  *********************************/
+  void    reset() {
+    sum = 0;
+    minSum = 0;
+    maxSum = 0;
+    count = 0;
+    head = 0;
+    seen = false;
+  }
+  void    add(sample_t x) {
+    sum += x;
+    if(count == N) {
+      sum -= window[head];
+    } else {
+      count++;
+    }
+    window[head] = x;
+    if(++head == N) {
+      head = 0;
+    }
+    if(count == N) {
+      if(sum > maxSum || !seen) {
+        maxSum = sum;
+      }
+      if(sum < minSum || !seen) {
+        minSum = sum;
+      }
+      seen = true;
+    }
+  }
+  bool    isValid() const { return seen; } // At least one full window was seen
+  double  getMin() const { return (double)minSum / N; }
+  double  getMax() const { return (double)maxSum / N; }
+
+private:
+/*********************************  OBJECTS  **********************************/
+  sample_t window[N];
+  typename SampleTraits<sample_t>::sum_t sum;
+  typename SampleTraits<sample_t>::sum_t minSum;
+  typename SampleTraits<sample_t>::sum_t maxSum;
+  unsigned int count;
+  unsigned int head;
+  bool seen;
+};
+
+#endif
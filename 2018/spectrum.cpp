@@ -0,0 +1,185 @@
+/*
+
+  Stanford Engineers for a Sustainable World
+  Remote Monitoring System | August 2018
+
+  File: spectrum.cpp
+  --------------------------
+  Implementation of spectrum.h
+
+*/
+#include <cmath>
+#include "spectrum.h"
+#include "wavesynth.h"
+#include "fixed_point.h"
+
+Spectrum::Spectrum() {
+    valid = false;
+    fundamental = 0;
+    thd = -1;
+    for(unsigned int i = 0; i < harmonic_count; i++) {
+        harmonics[i] = 0;
+    }
+}
+
+bool Spectrum::analyze(const sample_t *samples, unsigned int count, double interval, double minFrequency, double maxFrequency, bool rectified) {
+    valid = false;
+    fundamental = 0;
+    thd = -1;
+    for(unsigned int i = 0; i < harmonic_count; i++) {
+        harmonics[i] = 0;
+    }
+    if(count < 3 || interval <= 0) {
+        return false;
+    }
+
+    SampleTraits<sample_t>::sum_t sum = 0;
+    for(unsigned int i = 0; i < count; i++) {
+        sum += samples[i];
+    }
+    double mean = (double)sum / count;
+
+    const double lineScale = rectified ? 2 : 1;
+    const double sampleRate = 1000000. / interval;
+    double cyclesPerSample[max_tones] = {};
+    double amplitudes[max_tones];
+
+    // Coarse bank over the band, one tone past each edge so an edge peak can still be interpolated
+    unsigned int tones = 0;
+    for(double f = lineScale*minFrequency - bank_step; f <= lineScale*maxFrequency + bank_step && tones < max_tones; f += bank_step) {
+        cyclesPerSample[tones++] = f / sampleRate;
+    }
+    runBank(samples, count, mean, cyclesPerSample, amplitudes, tones);
+
+    unsigned int peak = 1;
+    for(unsigned int i = 2; i + 1 < tones; i++) {
+        if(amplitudes[i] > amplitudes[peak]) {
+            peak = i;
+        }
+    }
+    if(amplitudes[peak] <= 0) {
+        return false;
+    }
+
+    // The Hann main lobe is close to a gaussian, so a parabola through the log amplitudes finds its centre
+    double a = log(amplitudes[peak-1] > 0 ? amplitudes[peak-1] : 1e-12);
+    double b = log(amplitudes[peak]);
+    double c = log(amplitudes[peak+1] > 0 ? amplitudes[peak+1] : 1e-12);
+    double offset = (a - 2*b + c) < 0 ? .5 * (a - c) / (a - 2*b + c) : 0;
+    if(offset > .5) offset = .5;
+    if(offset < -.5) offset = -.5;
+    double line = (cyclesPerSample[peak] + offset * bank_step / sampleRate) * sampleRate;
+    fundamental = line / lineScale;
+
+    // Harmonics of the line frequency below nyquist
+    unsigned int harmonicTones = 0;
+    for(unsigned int n = 1; n <= harmonic_count && n * line < sampleRate / 2; n++) {
+        cyclesPerSample[harmonicTones++] = n * line / sampleRate;
+    }
+    runBank(samples, count, mean, cyclesPerSample, harmonics, harmonicTones);
+
+    if(!rectified && harmonics[0] > 0) {
+        double distortion = 0;
+        for(unsigned int n = 1; n < harmonic_count; n++) {
+            distortion += harmonics[n] * harmonics[n];
+        }
+        thd = sqrt(distortion) / harmonics[0];
+    }
+    valid = true;
+    return true;
+}
+
+// All tones advance together in one pass over the samples. Each is a Goertzel recurrence on the
+// Hann windowed, mean removed signal, scaled so a pure tone reports its peak amplitude.
+#if FIXED_POINT
+// The signal carries fraction_bits below the ADC count and the coefficients are Q29 (2cos reaches 2).
+// A state is at most the sum of |signal| over sin of its tone, under 2^30 for fixed_max_samples full-scale
+// samples 365 us apart at the lowest tone, so the recurrence runs in 32 bits with one 64-bit product per
+// tone. Sensors asserts its buffer is no longer. Samples closer together (a polled capture of one input)
+// bring a tone near 0 or nyquist, then the signal is shifted down until that bound holds again.
+void Spectrum::runBank(const sample_t *samples, unsigned int count, double mean, const double *cyclesPerSample, double *amplitudes, unsigned int tones) {
+    static const int fraction_bits = 4;
+    static const double state_max = 1 << 30;
+    int32_t coefficient[max_tones];
+    int32_t s1[max_tones];
+    int32_t s2[max_tones];
+    double lowestSin = 1;
+    for(unsigned int k = 0; k < tones; k++) {
+        coefficient[k] = (int32_t)floor(2.0 * cos(2.0 * pi * cyclesPerSample[k]) * (1 << 29) + .5);
+        s1[k] = 0;
+        s2[k] = 0;
+        lowestSin = fmin(lowestSin, fabs(sin(2.0 * pi * cyclesPerSample[k])));
+    }
+    int shift = 0;
+    for(double bound = count * (double)adc_max * (1 << fraction_bits) / 2 / lowestSin; bound > state_max && shift < 30; bound /= 2) {
+        shift++;
+    }
+
+    const int32_t offset = (int32_t)floor(mean * (1 << fraction_bits) + .5);
+    int64_t windowSum = 0;
+    FixedWaveSynth window(0, 2.0 * pi / (double)(count - 1));
+    for(unsigned int i = 0; i < count; i++, window.next()) {
+        int32_t w = (FixedWaveSynth::one - window.cos()) >> 1; // Q15
+        int32_t x = (int32_t)(((int64_t)(((int32_t)samples[i] << fraction_bits) - offset) * w) >> (15 + shift));
+        windowSum += w;
+        for(unsigned int k = 0; k < tones; k++) {
+            int32_t s0 = x + (int32_t)(((int64_t)coefficient[k] * s1[k] + (1 << 28)) >> 29) - s2[k];
+            s2[k] = s1[k];
+            s1[k] = s0;
+        }
+    }
+
+    const double unit = ldexp(1.0, shift - fraction_bits);
+    const double weight = (double)windowSum / FixedWaveSynth::one;
+    for(unsigned int k = 0; k < tones; k++) {
+        double a = s1[k] * unit, b = s2[k] * unit, c = (double)coefficient[k] / (1 << 29);
+        double power = a*a + b*b - c*a*b;
+        amplitudes[k] = power > 0 ? 2.0 * sqrt(power) / weight : 0;
+    }
+}
+#else
+void Spectrum::runBank(const sample_t *samples, unsigned int count, double mean, const double *cyclesPerSample, double *amplitudes, unsigned int tones) {
+    double coefficient[max_tones];
+    double s1[max_tones];
+    double s2[max_tones];
+    for(unsigned int k = 0; k < tones; k++) {
+        coefficient[k] = 2.0 * cos(2.0 * pi * cyclesPerSample[k]);
+        s1[k] = 0;
+        s2[k] = 0;
+    }
+
+    double windowSum = 0;
+    WaveSynth window(0, 2.0 * pi / (double)(count - 1));
+    for(unsigned int i = 0; i < count; i++, window.next()) {
+        double w = .5 - .5 * window.cos();
+        double x = (samples[i] - mean) * w;
+        windowSum += w;
+        for(unsigned int k = 0; k < tones; k++) {
+            double s0 = x + coefficient[k] * s1[k] - s2[k];
+            s2[k] = s1[k];
+            s1[k] = s0;
+        }
+    }
+
+    for(unsigned int k = 0; k < tones; k++) {
+        double power = s1[k]*s1[k] + s2[k]*s2[k] - coefficient[k]*s1[k]*s2[k];
+        amplitudes[k] = power > 0 ? 2.0 * sqrt(power) / windowSum : 0;
+    }
+}
+#endif
+
+bool Spectrum::isValid() {
+    return valid;
+}
+
+double Spectrum::getFundamental() {
+    return fundamental;
+}
+
+double Spectrum::getHarmonic(unsigned int n) {
+    return n >= 1 && n <= harmonic_count ? harmonics[n-1] : 0;
+}
+
+double Spectrum::getTHD() {
+    return thd;
+}
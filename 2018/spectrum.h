@@ -0,0 +1,52 @@
+/*
+
+  Stanford Engineers for a Sustainable World
+  Remote Monitoring System | August 2018
+
+  File: spectrum.h
+  --------------------------
+  Goertzel filter bank for the fundamental frequency and harmonic content of one captured wave.
+  A Hann windowed bank of tones spaced bank_step apart covers the search band in one pass, the peak
+  is interpolated between its neighbours, then a second pass measures the harmonics of that peak.
+  Cost is fixed by the band width and harmonic_count, not by the signal.
+
+*/
+
+#ifndef SPECTRUM_H
+#define SPECTRUM_H
+
+#include "sample.h"
+
+class Spectrum {
+public:
+/**********************************  SETUP  ***********************************/
+  Spectrum ();
+
+/********************************  FUNCTIONS  *********************************/
+  // interval is the sample spacing in us. Rectified waves carry the line frequency at twice the
+  // fundamental, so the band is doubled and the harmonics are those of the rectified wave.
+  bool    analyze(const sample_t *samples, unsigned int count, double interval, double minFrequency, double maxFrequency, bool rectified);
+  bool    isValid();
+  double  getFundamental(); // Hz
+  double  getHarmonic(unsigned int n); // Peak amplitude in ADC counts, 1 = fundamental
+  double  getTHD(); // Ratio of harmonics 2..harmonic_count to the fundamental, -1 for rectified waves
+
+  static const unsigned int harmonic_count = 7;
+  static const unsigned int fixed_max_samples = 2000; // Most samples the fixed-point bank's 32-bit states are shown to hold
+
+private:
+/*********************************  HELPERS  **********************************/
+  void    runBank(const sample_t *samples, unsigned int count, double mean, const double *cyclesPerSample, double *amplitudes, unsigned int tones);
+
+/*********************************  OBJECTS  **********************************/
+  static constexpr double pi = 3.1415926535;
+  static constexpr double bank_step = 1; // Hz between bank tones, the Hann main lobe is ~4/0.73s wide
+  static const unsigned int max_tones = 64;
+
+  bool valid;
+  double fundamental;
+  double harmonics[harmonic_count];
+  double thd;
+};
+
+#endif
@@ -0,0 +1,435 @@
+/*
+
+  Stanford Engineers for a Sustainable World
+  Remote Monitoring System | August 2018
+  Michael Lin | mlin4@stanford.edu
+
+  File: transmitter.cpp
+  --------------------------
+  Implementation of transmitter.h, the main electron code
+
+*/
+
+#include "cellular_hal.h"
+#include <math.h>
+#include "transmitter.h"
+
+Transmitter::Transmitter(ConnectionStats &linkStats, EnergyLedger &ledger) :
+    linkStats(linkStats), ledger(ledger), connectTimer(3*60*1000, &Transmitter::resetElectron, *this) {
+}
+
+void Transmitter::setup() {
+    Serial.begin(9600); // for testing
+    
+    Sensorboard.init();
+
+    EEPROM.get(2000, publishedAll);
+    EEPROM.get(2030, offline);
+    measurementLog.init();
+    linkStats.init();
+    ledger.init(linkStats, Time.isValid() ? Time.now() : 0);
+    retryBackoff.begin(retry_first, retry_max);
+
+    //turns off cellular module
+    Serial.println("turning off cellular");
+    Cellular.off();
+    Serial.println("delaying 5 sec");
+    delay(5000);
+
+    //highest priority first, each starts one period after boot like the old polling did
+    #ifdef STATUS_CHANGE
+    statusTask = scheduler.add(task<&Transmitter::checkStatus>, this, 4, status_frequency);
+    generatorMonitor.begin(site_channels[0].pin, Sensorboard.getStatusLevel());
+    Sensorboard.shareADC(generatorMonitor); //paused by every capture and status check, FIELD_TEST's included
+    #endif
+    #ifdef MEASURE
+    scheduler.add(task<&Transmitter::measure>, this, 3, measurement_frequency);
+    #endif
+    scheduler.add(task<&Transmitter::checkTime>, this, 2, 0);
+    scheduler.add(task<&Transmitter::requestPublish>, this, 1, publishedAll == 'n' || statusUnsent() ? 0 : publish_frequency);
+    sessionTask = scheduler.add(task<&Transmitter::runSession>, this, 0, Scheduler::never);
+}
+
+void Transmitter::loop(){
+    #ifdef FIELD_TEST
+    Sensorboard.fieldTest();
+    #endif
+    #ifndef PLATFORM_ID
+    if (monitorPolling) {
+        generatorMonitor.poll(); //no timers on the host
+    }
+    #endif
+    if (generatorMonitor.hasChange()) {
+        scheduler.wake(statusTask);
+    }
+    if (scheduler.runNext()) {
+        ledger.recordTask(scheduler.lastTask(), scheduler.lastBusy());
+    } else {
+        //nothing due, idle until the next deadline but come back at least every second
+        unsigned long wait = scheduler.untilNext();
+        delay(wait < 1000 ? wait : 1000);
+    }
+}
+
+#ifndef PLATFORM_ID
+void Transmitter::setMonitorPolling(bool polling) {
+    monitorPolling = polling;
+}
+#endif
+
+void Transmitter::resetElectron() {
+    ledger.recordReset(EnergyLedger::timer_reset);
+    System.reset();
+}
+
+unsigned long Transmitter::checkTime() {
+    if (Time.format("%y").toInt() < 18 || Time.format("%y").toInt() > 70) {
+        syncPending = true;
+        startSession();
+    }
+    return 24*60*60*1000;
+}
+
+#ifdef STATUS_CHANGE
+//woken by generatorMonitor on a change, and every status_frequency in case it missed one
+//recordStatus() only records a status that differs from the last one recorded
+unsigned long Transmitter::checkStatus() {
+    unsigned long when;
+    if (generatorMonitor.takeChange(when)) {
+        Serial.println("generator status changed");
+        recordStatus(generatorMonitor.isOn(), when);
+    } else if (generatorMonitor.isKnown()) {
+        recordStatus(generatorMonitor.isOn(), millis());
+    } else {
+        Serial.println("checking status");
+        Sensorboard.refreshStatus();
+        recordStatus(Sensorboard.generatorIsOn(), millis());
+    }
+    return status_frequency;
+}
+#endif
+
+void Transmitter::recordStatus(bool on, unsigned long when) {
+    if (offline == 'y') {
+        if (on) {
+            putInEEPROM("on,", 1900, when);
+            offline = 'n';
+            EEPROM.put(2030, offline);
+            statusPending = true;
+            startSession();
+        }
+    } else {
+        if (!on) {
+            putInEEPROM("off,", 1800, when);
+            offline = 'y';
+            EEPROM.put(2030, offline);
+            statusPending = true;
+            startSession();
+        }
+    }
+}
+
+#ifdef MEASURE
+#ifdef DUMPCAPTURES
+class SerialCaptureSink : public CaptureSink {
+public:
+    void write(const uint8_t *data, unsigned int length) {
+        Serial.write(data, length);
+    }
+};
+#endif
+
+unsigned long Transmitter::measure() {
+    Serial.println("measuring\n\n\n");
+    Sensorboard.refreshAll();
+    #ifdef DUMPCAPTURES
+    SerialCaptureSink sink;
+    Sensorboard.writeCapture(sink, Time.isValid() ? Time.now() : 0);
+    #endif
+    storeMeasurements();
+    return measurement_frequency;
+}
+#endif
+
+unsigned long Transmitter::requestPublish() {
+    Serial.println("publishing\n\n\n");
+    publishPending = true;
+    startSession();
+    return publish_frequency;
+}
+
+void Transmitter::putInEEPROM(const char *message, int address, unsigned long when) { //this is to put the time off/on into the eeprom
+    char stringBuf[status_string_size] = {};
+    PayloadWriter str(stringBuf, sizeof(stringBuf));
+    time_t t = Time.now() - (millis() - when) / 1000; //when the change happened, not when it was handled
+    str.append(message);
+    str.appendf("%02d%02d%02d%02d%02d", Time.day(t), Time.month(t), Time.year(t) % 100, Time.hour(t), Time.minute(t));
+    EEPROM.put(address, stringBuf);
+}
+
+void Transmitter::storeMeasurements() { //EEPROM
+    LogRecord record;
+    record.current_1 = Sensorboard.getCurrent_1();
+    record.current_2 = Sensorboard.getCurrent_2();
+    record.current_3 = Sensorboard.getCurrent_3();
+    record.frequency = Sensorboard.getFrequency();
+    record.voltage = Sensorboard.getVoltage();
+    record.power = Sensorboard.getPower();
+    measurementLog.append(record);
+    Serial.println("finished storing measurements\n\n\n");
+}
+
+//a session that is already running picks up new work when it reaches the cloud
+void Transmitter::startSession() {
+    if (session == SESSION_OFF) {
+        scheduler.wake(sessionTask);
+    }
+}
+
+//one cellular session as a state machine, each step returns instead of waiting so sensing goes on
+//turns cellular on and polls until it is ready, backing off up to poll_max
+//once the cloud is connected, does the pending status publish, data publish (a batch a step) and time sync
+//and disconnects as soon as they are out, a backlog only partly out goes again after retryBackoff
+//if does not connect to cellular, resets system
+unsigned long Transmitter::runSession() {
+    switch (session) {
+    case SESSION_OFF:
+        if (!statusPending && !publishPending && !syncPending) {
+            return Scheduler::never;
+        }
+        cellular_credentials_set("internet", "wap", "wap123", NULL);
+        Serial.println("calling cellular.on");
+        Cellular.on();
+        sessionStart = millis();
+        sessionPublishTime = 0;
+        sessionSyncTime = 0;
+        
+        Serial.println("starting timer");
+        connectTimer.start();
+        
+        Serial.println("calling cellular.connect");
+        Cellular.connect();
+        
+        Serial.println("resetting timer");
+        connectTimer.reset();
+        Serial.println("stopping timer");
+        connectTimer.stop();
+        session = SESSION_CELLULAR;
+        stepStart = millis();
+        backoff.begin(poll_first, poll_max);
+        return backoff.next();
+
+    case SESSION_CELLULAR:
+        if (!Cellular.ready()) {
+            if (millis() - stepStart < cellular_timeout) {
+                return backoff.next();
+            }
+            linkStats.recordCellularFailure();
+            Serial.println("system is being reset");
+            ledger.recordReset(EnergyLedger::cellular_reset);
+            System.reset();
+        }
+        linkStats.recordCellular(millis() - stepStart);
+        Serial.println("connecting to electron");
+        Particle.connect();
+        session = SESSION_CLOUD;
+        stepStart = millis();
+        backoff.begin(poll_first, poll_max);
+        return backoff.next();
+
+    case SESSION_CLOUD:
+        if (!Particle.connected()) {
+            if (millis() - stepStart < cloud_timeout) {
+                return backoff.next();
+            }
+            //anything that did not go out stays in EEPROM for the next session
+            linkStats.recordCloudFailure();
+            closeSession();
+            return Scheduler::never;
+        }
+        linkStats.recordCloud(millis() - stepStart);
+        Serial.println("particle connected, trying to publish to cloud");
+        if (statusPending || publishPending) {
+            publishStatus(); //status strings go out ahead of the data
+            statusPending = false;
+        }
+        session = SESSION_PUBLISH;
+        return 0;
+
+    case SESSION_PUBLISH:
+        //one batch a step, publish_gap apart for the cloud's rate limit, so sensing goes on in between
+        if (statusPending) {
+            publishStatus(); //a change while the batches were going out
+            statusPending = false;
+        }
+        if (publishPending) {
+            bool sent = publishNextBatch();
+            if (sent && measurementLog.pending() > 0) {
+                return publish_gap;
+            }
+            if (sent) {
+                Serial.println("publish worked");
+                retryBackoff.begin(retry_first, retry_max);
+            }
+            #ifdef PUBLISH_PROFILE
+            publishProfile();
+            #endif
+            publishPending = false;
+        }
+        #ifdef PUBLISH_LEDGER
+        publishLedger();
+        #endif
+        if (syncPending) {
+            Particle.syncTime();
+            syncPending = false;
+            session = SESSION_SYNC;
+            stepStart = millis();
+            backoff.begin(poll_first, poll_max);
+            return backoff.next();
+        }
+        session = SESSION_FLUSH;
+        return flush_time;
+
+    case SESSION_SYNC:
+        if (Particle.syncTimePending() && millis() - stepStart < sync_timeout) {
+            return backoff.next();
+        }
+        sessionSyncTime = millis() - stepStart;
+        session = SESSION_FLUSH;
+        return flush_time;
+
+    case SESSION_FLUSH:
+        closeSession();
+        if (statusPending || publishPending || syncPending) {
+            return 0; //work that came in while the session ran
+        }
+        if (publishedAll == 'n' || statusUnsent()) {
+            publishPending = true; //only part of the backlog or a status string went out, try again later and later
+            return retryBackoff.next();
+        }
+        return Scheduler::never;
+    }
+    return Scheduler::never;
+}
+
+void Transmitter::closeSession() {
+    Serial.println("disconnecting from cloud");
+    Particle.disconnect();
+    Serial.println("disconnecting from cellular");
+    Cellular.disconnect();
+    Serial.println("turning cellular off");
+    Cellular.off();
+    session = SESSION_OFF;
+    linkStats.recordSession(millis() - sessionStart);
+    ledger.recordSession(millis() - sessionStart, sessionPublishTime, sessionSyncTime);
+    Serial.printlnf("session %lu ms, cellular mean %lu max %lu fails %lu, cloud mean %lu max %lu fails %lu",
+        millis() - sessionStart, (unsigned long)linkStats.meanCellular(), (unsigned long)linkStats.cellularMax, (unsigned long)linkStats.cellularFailures,
+        (unsigned long)linkStats.meanCloud(), (unsigned long)linkStats.cloudMax, (unsigned long)linkStats.cloudFailures);
+}
+
+void Transmitter::publishStatus(){
+    bool sent;
+
+    unsigned char stopped;
+    EEPROM.get(1800, stopped);
+    unsigned char started;
+    EEPROM.get(1900, started);
+    Payload<2 * status_string_size> total;
+    char stringBuf[status_string_size];
+    if (stopped != 0xFF) {
+        EEPROM.get(1800, stringBuf);
+        stringBuf[status_string_size - 1] = 0;
+        total.append(stringBuf);
+    }
+    if (started != 0xFF) {
+        EEPROM.get(1900, stringBuf);
+        stringBuf[status_string_size - 1] = 0;
+        total.append(stringBuf);
+    }
+    if (!total.isEmpty()) {
+        sent = publishEvent("DATA", total.c_str());
+        if (sent) {
+            EEPROM.put(1800, 0xFF);
+            EEPROM.put(1900, 0xFF);
+        }
+    }
+}
+
+//a status string stays in EEPROM until a publish of it worked
+bool Transmitter::statusUnsent() {
+    unsigned char stopped;
+    EEPROM.get(1800, stopped);
+    unsigned char started;
+    EEPROM.get(1900, started);
+    return stopped != 0xFF || started != 0xFF;
+}
+
+//every publish goes through here so the ledger sees its size and the modem time it took
+bool Transmitter::publishEvent(const char *name, const char *data) {
+    unsigned long start = millis();
+    bool sent = Particle.publish(name, data, 60);
+    sessionPublishTime += millis() - start;
+    ledger.recordPublish(strlen(name) + strlen(data), sent);
+    return sent;
+}
+
+//publishes the energy ledger once it covers ledger_period, then starts a new one
+void Transmitter::publishLedger() {
+    uint32_t now = Time.isValid() ? Time.now() : 0;
+    Payload<200> summary;
+    if (ledger.elapsed(now) >= ledger_period && ledger.appendSummary(summary, linkStats, now)) {
+        if (publishEvent("LEDG", summary.c_str())) {
+            ledger.clear(linkStats, now);
+        }
+    }
+}
+
+//publishes the analysis profile of the measurements since the last one
+void Transmitter::publishProfile() {
+    MeasurementProfiler &profiler = Sensorboard.getProfiler();
+    Payload<200> summary;
+    if (profiler.getMeasurements() > 0 && profiler.appendSummary(summary)) {
+        if (publishEvent("PROF", summary.c_str())) {
+            profiler.clearTotals();
+        }
+    }
+}
+
+//publishes the oldest pending records as one wire_format.h batch, the first batch of a backlog carries the time
+//false if it did not go out, the records stay in the log
+bool Transmitter::publishNextBatch(){
+    unsigned int counter = 0;
+
+    encoder.begin(measurementLog.pending(), publishedAll != 'n' ? Time.now() : 0);
+    while (counter < measurementLog.pending()) {
+        LogRecord record;
+        if (!measurementLog.read(counter, record)) {
+            Serial.println("skipping corrupt record");
+            counter++;
+        } else if (encoder.getCount() < records_per_publish && encoder.add(record)) {
+            counter++;
+        } else {
+            break;
+        }
+    }
+    if (counter > 0 && encoder.getCount() == 0) {
+        measurementLog.markPublished(counter); //only corrupt records, a header-only batch would cost a publish for nothing
+    } else if (counter > 0 && !publishBatch(counter)) {
+        return false;
+    }
+    publishedAll = measurementLog.pending() != 0 ? 'n' : 'y';
+    EEPROM.put(2000, publishedAll);
+    return true;
+}
+
+//publishes the encoder's batch, which covers the oldest count records of the log
+bool Transmitter::publishBatch(unsigned int count) {
+    const char *batch = encoder.finish();
+    Serial.print("this is what im publishing: ");
+    Serial.println(batch);
+    if (!publishEvent("DATA", batch)) {
+        return false;
+    }
+    measurementLog.markPublished(count);
+    return true;
+}
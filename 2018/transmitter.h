@@ -0,0 +1,136 @@
+/*
+
+  Stanford Engineers for a Sustainable World
+  Remote Monitoring System | August 2018
+  Michael Lin | mlin4@stanford.edu
+
+  File: transmitter.h
+  --------------------------
+  Everything one monitoring board does, run by main.cpp on the Electron: the status, measurement,
+  publish and time tasks on the scheduler, the EEPROM log and status strings, and the cellular session
+  that sends them. It is a class so the host can run many of them at once (host/fleet.cpp). The stats
+  that have to survive a reset live in retained memory outside it and are passed in.
+
+*/
+
+#ifndef TRANSMITTER_H
+#define TRANSMITTER_H
+
+#include "application.h"
+#include "sensors.h"
+#include "measurement_log.h"
+#include "wire_format.h"
+#include "payload.h"
+#include "scheduler.h"
+#include "connection.h"
+#include "generator_monitor.h"
+#include "energy_ledger.h"
+
+//for version 3, define status_change and measure
+//for version 2, define measure
+//for failsafe, define status_change
+
+#define STATUS_CHANGE
+#define MEASURE
+//#define SINGLE_RECORDS // One record per DATA publish, what TEST builds did before batching
+#ifdef PLATFORM_ID
+  #define FIELD_TEST // Measures in a loop forever instead of running the tasks, Electron only
+#endif
+#define PUBLISH_PROFILE // Publishes where the analysis time went (profiler.h) along with the data
+#define PUBLISH_LEDGER // Publishes the energy ledger (energy_ledger.h) once every ledger_period
+//#define DUMPCAPTURES // Writes each measurement's capture to Serial for host/replay, see capture.h
+
+class Transmitter {
+public:
+/**********************************  SETUP  ***********************************/
+  Transmitter(ConnectionStats &linkStats, EnergyLedger &ledger); // Both retained
+
+/********************************  FUNCTIONS  *********************************/
+  void    setup();
+  void    loop();
+  #ifndef PLATFORM_ID
+    void  setMonitorPolling(bool polling); // Host only, whether loop() catches the generator monitor up
+  #endif
+
+  static const int status_string_size = 15; // "off," and %d%m%y%H%M, terminated
+  static const unsigned long ledger_period = 24*60*60; //seconds between ledger summaries
+
+private:
+/*********************************  HELPERS  **********************************/
+  // Scheduler tasks, each a step that returns the ms until the next one
+  unsigned long checkTime();
+  unsigned long checkStatus();
+  unsigned long measure();
+  unsigned long requestPublish();
+  unsigned long runSession();
+  template <unsigned long (Transmitter::*Step)()> static unsigned long task(void *transmitter) {
+    return (static_cast<Transmitter *>(transmitter)->*Step)();
+  }
+
+  void    resetElectron();
+  void    startSession();
+  void    closeSession();
+  void    putInEEPROM(const char *message, int address, unsigned long when);
+  void    recordStatus(bool on, unsigned long when);
+  bool    publishNextBatch();
+  bool    publishBatch(unsigned int count);
+  bool    publishEvent(const char *name, const char *data);
+  void    publishProfile();
+  void    publishLedger();
+  void    storeMeasurements();
+  void    publishStatus();
+  bool    statusUnsent();
+
+/*********************************  OBJECTS  **********************************/
+  Sensors Sensorboard;
+  GeneratorMonitor generatorMonitor;
+  MeasurementLog measurementLog;
+  WireEncoder encoder;
+
+  unsigned long status_frequency = 5*60*1000; //milliseconds, fallback check, generatorMonitor reports changes as they happen
+  unsigned long measurement_frequency = 60*60*1000; //change to 5*60*1000 for testing
+  unsigned long publish_frequency = 4*60*60*1000; //change to 5*60*1000 for testing
+  #ifdef SINGLE_RECORDS
+  static const unsigned int records_per_publish = 1;
+  #else
+  static const unsigned int records_per_publish = WireEncoder::max_records; // As many as fit
+  #endif
+  unsigned char publishedAll;
+  unsigned char offline;
+
+  //work for the next cellular session
+  bool statusPending = false;
+  bool publishPending = false;
+  bool syncPending = false;
+
+  enum SessionState { SESSION_OFF, SESSION_CELLULAR, SESSION_CLOUD, SESSION_PUBLISH, SESSION_SYNC, SESSION_FLUSH };
+  SessionState session = SESSION_OFF;
+  unsigned long sessionStart; //when the modem went on
+  unsigned long sessionPublishTime; //ms spent in publishEvent() this session
+  unsigned long sessionSyncTime; //ms waiting on the time sync this session
+  unsigned long stepStart; //when the current wait began
+  Backoff backoff;
+  Backoff retryBackoff; //between sessions that only got part of the backlog out
+  ConnectionStats &linkStats;
+  EnergyLedger &ledger;
+
+  static const unsigned long cellular_timeout = 2*60*1000; //resets the system, like a failed connect always did
+  static const unsigned long cloud_timeout = 1*60*1000;
+  static const unsigned long sync_timeout = 10*1000;
+  static const unsigned long flush_time = 2*1000; //lets the system thread send the last publish before disconnecting
+  static const unsigned long publish_gap = 1000; //between DATA batches, the cloud takes about one event a second
+  static const unsigned long poll_first = 250;
+  static const unsigned long poll_max = 8*1000;
+  static const unsigned long retry_first = 5*60*1000;
+  static const unsigned long retry_max = 60*60*1000;
+
+  Scheduler scheduler;
+  int sessionTask;
+  int statusTask = -1;
+  Timer connectTimer;
+  #ifndef PLATFORM_ID
+    bool monitorPolling = true;
+  #endif
+};
+
+#endif
@@ -0,0 +1,44 @@
+/*
+
+  Stanford Engineers for a Sustainable World
+  Remote Monitoring System | August 2018
+
+  File: wavesynth.cpp
+  --------------------------
+  Implementation of wavesynth.h
+
+*/
+#include <cmath>
+#include "wavesynth.h"
+
+WaveSynth::WaveSynth(double phase, double step) {
+    c = std::cos(phase);
+    s = std::sin(phase);
+    stepCos = std::cos(step);
+    stepSin = std::sin(step);
+    count = 0;
+}
+
+// One Newton step towards unit length - the error after 64 rotations is far below what this corrects
+void WaveSynth::renormalize() {
+    double k = 1.5 - .5*(c*c + s*s);
+    c *= k;
+    s *= k;
+    count = 0;
+}
+
+FixedWaveSynth::FixedWaveSynth(double phase, double step) {
+    c = (int32_t)std::floor(std::cos(phase) * (1 << 30) + .5);
+    s = (int32_t)std::floor(std::sin(phase) * (1 << 30) + .5);
+    stepCos = (int32_t)std::floor(std::cos(step) * (1 << 30) + .5);
+    stepSin = (int32_t)std::floor(std::sin(step) * (1 << 30) + .5);
+    count = 0;
+}
+
+// The same Newton step in Q30, c*c + s*s is Q60
+void FixedWaveSynth::renormalize() {
+    int64_t k = (3LL << 29) - (((int64_t)c*c + (int64_t)s*s) >> 31);
+    c = (int32_t)(((int64_t)c*k + half_q30) >> 30);
+    s = (int32_t)(((int64_t)s*k + half_q30) >> 30);
+    count = 0;
+}
@@ -0,0 +1,88 @@
+/*
+
+  Stanford Engineers for a Sustainable World
+  Remote Monitoring System | August 2018
+
+  File: wavesynth.h
+  --------------------------
+  Incremental sine/cosine synthesis for the wave models. Instead of calling cos() per sample the
+  unit vector (cos, sin) is rotated by a fixed step each sample, which is four multiplies and two adds.
+  Rounding makes the vector's length wander, so it is pulled back to 1 every renormalize_n steps.
+  FixedWaveSynth is the same rotation in integers for the fixed-point build (fixed_point.h).
+
+*/
+
+#ifndef WAVESYNTH_H
+#define WAVESYNTH_H
+
+#include <stdint.h>
+
+class WaveSynth {
+public:
+/**********************************  SETUP  ***********************************/
+  WaveSynth(double phase, double step); // Radians at sample 0, radians per sample
+
+/********************************  FUNCTIONS  *********************************/
+  double  cos() const { return c; }
+  double  sin() const { return s; }
+  double  wave(bool rectified) const { return rectified ? (c < 0 ? -c : c) : c; }
+  void    next() {
+    double t = c*stepCos - s*stepSin;
+    s = s*stepCos + c*stepSin;
+    c = t;
+    if(++count == renormalize_n) {
+      renormalize();
+    }
+  }
+
+private:
+/*********************************  HELPERS  **********************************/
+  void    renormalize();
+
+/*********************************  OBJECTS  **********************************/
+  static const unsigned int renormalize_n = 64;
+  double c;
+  double s;
+  double stepCos;
+  double stepSin;
+  unsigned int count;
+};
+
+// The vector is held in Q30 so a length a little over 1 can not overflow, and read out in Q15 so
+// products of two values and their sums over a capture fit in 64 bits
+class FixedWaveSynth {
+public:
+/**********************************  SETUP  ***********************************/
+  FixedWaveSynth(double phase, double step);
+
+/********************************  FUNCTIONS  *********************************/
+  int32_t cos() const { return (c + half_q15) >> 15; } // Q15
+  int32_t sin() const { return (s + half_q15) >> 15; }
+  int32_t wave(bool rectified) const { return rectified && c < 0 ? -cos() : cos(); }
+  void    next() {
+    int32_t t = (int32_t)(((int64_t)c*stepCos - (int64_t)s*stepSin + half_q30) >> 30);
+    s = (int32_t)(((int64_t)s*stepCos + (int64_t)c*stepSin + half_q30) >> 30);
+    c = t;
+    if(++count == renormalize_n) {
+      renormalize();
+    }
+  }
+
+  static const int32_t one = 1 << 15; // Q15
+
+private:
+/*********************************  HELPERS  **********************************/
+  void    renormalize();
+
+/*********************************  OBJECTS  **********************************/
+  static const unsigned int renormalize_n = 64;
+  static const int32_t half_q15 = 1 << 14;
+  static const int64_t half_q30 = 1 << 29;
+  int32_t c; // Q30
+  int32_t s;
+  int32_t stepCos;
+  int32_t stepSin;
+  unsigned int count;
+};
+
+#endif
@@ -0,0 +1,201 @@
+/*
+
+  Stanford Engineers for a Sustainable World
+  Remote Monitoring System | August 2018
+
+  File: wire_format.cpp
+  --------------------------
+  Implementation of wire_format.h
+
+*/
+#include <string.h>
+#include "wire_format.h"
+
+static const unsigned int field_count = 6;
+static const unsigned int max_record_bytes = 3 + field_count * 3; // uint16 deltas zigzag to 17 bits
+static const char base64_alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static void getFields(const LogRecord &record, uint16_t *fields) {
+    fields[0] = record.current_1;
+    fields[1] = record.current_2;
+    fields[2] = record.current_3;
+    fields[3] = record.frequency;
+    fields[4] = record.voltage;
+    fields[5] = record.power;
+}
+
+static void setFields(LogRecord &record, const uint16_t *fields) {
+    record.current_1 = fields[0];
+    record.current_2 = fields[1];
+    record.current_3 = fields[2];
+    record.frequency = fields[3];
+    record.voltage = fields[4];
+    record.power = fields[5];
+}
+
+static unsigned int putVarint(uint8_t *out, uint32_t value) {
+    unsigned int n = 0;
+    while(value >= 0x80) {
+        out[n++] = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    out[n++] = value;
+    return n;
+}
+
+static bool getVarint(const uint8_t *in, unsigned int length, unsigned int &position, uint32_t &value) {
+    value = 0;
+    for(int shift = 0; shift < 32 && position < length; shift += 7) {
+        uint8_t byte = in[position++];
+        value |= (uint32_t)(byte & 0x7F) << shift;
+        if(!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static uint32_t zigzag(int32_t value) {
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static int32_t unzigzag(uint32_t value) {
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+static int base64Value(char c) {
+    const char *p = c ? strchr(base64_alphabet, c) : 0;
+    return p ? p - base64_alphabet : -1;
+}
+
+WireEncoder::WireEncoder() {
+    begin(0, 0);
+}
+
+void WireEncoder::begin(unsigned int remaining, uint32_t time) {
+    length = 0;
+    count = 0;
+    binary[length++] = wire_version;
+    binary[length++] = time ? 1 : 0;
+    length += putVarint(binary + length, remaining);
+    if(time) {
+        for(int i = 0; i < 4; i++) {
+            binary[length++] = time >> (8 * i);
+        }
+    }
+    text[0] = 0;
+}
+
+bool WireEncoder::add(const LogRecord &record) {
+    uint8_t packed[max_record_bytes];
+    unsigned int n = 0;
+    uint16_t fields[field_count];
+    getFields(record, fields);
+    if(count == 0) {
+        n += putVarint(packed + n, record.sequence);
+        for(unsigned int i = 0; i < field_count; i++) {
+            n += putVarint(packed + n, fields[i]);
+        }
+    } else {
+        uint16_t last[field_count];
+        getFields(previous, last);
+        n += putVarint(packed + n, (uint16_t)(record.sequence - previous.sequence - 1));
+        for(unsigned int i = 0; i < field_count; i++) {
+            n += putVarint(packed + n, zigzag((int32_t)fields[i] - (int32_t)last[i]));
+        }
+    }
+    if(length + n > max_binary || count == max_records) {
+        return false;
+    }
+    memcpy(binary + length, packed, n);
+    length += n;
+    previous = record;
+    count++;
+    return true;
+}
+
+const char *WireEncoder::finish() {
+    unsigned int t = 0;
+    for(unsigned int i = 0; i < length; i += 3) {
+        uint32_t group = (uint32_t)binary[i] << 16;
+        if(i + 1 < length) group |= (uint32_t)binary[i + 1] << 8;
+        if(i + 2 < length) group |= binary[i + 2];
+        text[t++] = base64_alphabet[(group >> 18) & 0x3F];
+        text[t++] = base64_alphabet[(group >> 12) & 0x3F];
+        text[t++] = i + 1 < length ? base64_alphabet[(group >> 6) & 0x3F] : '=';
+        text[t++] = i + 2 < length ? base64_alphabet[group & 0x3F] : '=';
+    }
+    text[t] = 0;
+    return text;
+}
+
+unsigned int WireEncoder::getCount() {
+    return count;
+}
+
+bool decodeWireBatch(const char *text, WireBatch &batch) {
+    uint8_t binary[WireEncoder::max_binary];
+    unsigned int length = 0;
+    unsigned int textLength = strlen(text);
+    if(textLength % 4 != 0 || textLength / 4 * 3 > WireEncoder::max_binary) {
+        return false;
+    }
+    for(unsigned int i = 0; i < textLength; i += 4) {
+        int values[4];
+        int padding = 0;
+        for(int j = 0; j < 4; j++) {
+            if(text[i + j] == '=' && i + 4 == textLength && j >= 2) {
+                values[j] = 0;
+                padding++;
+            } else if(padding > 0 || (values[j] = base64Value(text[i + j])) < 0) {
+                return false;
+            }
+        }
+        uint32_t group = (values[0] << 18) | (values[1] << 12) | (values[2] << 6) | values[3];
+        binary[length++] = group >> 16;
+        if(padding < 2) binary[length++] = group >> 8;
+        if(padding < 1) binary[length++] = group;
+    }
+
+    unsigned int position = 0;
+    uint32_t value;
+    if(length < 2 || binary[0] != wire_version) {
+        return false;
+    }
+    batch.version = binary[position++];
+    uint8_t flags = binary[position++];
+    if(!getVarint(binary, length, position, value)) {
+        return false;
+    }
+    batch.remaining = value;
+    batch.time = 0;
+    if(flags & 1) {
+        if(position + 4 > length) {
+            return false;
+        }
+        for(int i = 0; i < 4; i++) {
+            batch.time |= (uint32_t)binary[position++] << (8 * i);
+        }
+    }
+
+    batch.count = 0;
+    uint16_t fields[field_count] = {};
+    uint16_t sequence = 0;
+    while(position < length) {
+        if(batch.count == WireEncoder::max_records || !getVarint(binary, length, position, value)) {
+            return false;
+        }
+        sequence = batch.count == 0 ? value : sequence + value + 1;
+        for(unsigned int i = 0; i < field_count; i++) {
+            if(!getVarint(binary, length, position, value)) {
+                return false;
+            }
+            fields[i] = batch.count == 0 ? value : fields[i] + unzigzag(value);
+        }
+        LogRecord &record = batch.records[batch.count++];
+        record.sequence = sequence;
+        setFields(record, fields);
+        record.crc = 0;
+    }
+    return true;
+}
@@ -0,0 +1,67 @@
+/*
+
+  Stanford Engineers for a Sustainable World
+  Remote Monitoring System | August 2018
+
+  File: wire_format.h
+  --------------------------
+  Packed encoding of logged measurements for DATA publishes. A batch is binary, base64 encoded so it
+  fits a publish as text, and holds as many records as the 622 byte event limit allows.
+
+  Binary layout, varints are unsigned LEB128 and deltas are zigzag varints:
+    version                 1 byte, wire_version
+    flags                   1 byte, bit 0 set if a time follows
+    remaining               varint, records left to publish including this batch
+    time                    4 bytes little endian Unix time, only if flagged
+    first record            varint sequence, then current_1, current_2, current_3, frequency, voltage,
+                            power as varints
+    every later record      varint sequence gap (0 if it follows the previous one), then the six
+                            fields as deltas from the previous record
+
+  Hourly records barely change, so most fields take a byte and a batch carries around 50 records.
+
+*/
+
+#ifndef WIRE_FORMAT_H
+#define WIRE_FORMAT_H
+
+#include <stdint.h>
+#include "measurement_log.h"
+
+class WireEncoder {
+public:
+/**********************************  SETUP  ***********************************/
+  WireEncoder();
+
+/********************************  FUNCTIONS  *********************************/
+  void    begin(unsigned int remaining, uint32_t time); // time 0 leaves it out
+  bool    add(const LogRecord &record); // false if the batch is full, the record is left out
+  const char *  finish(); // Base64 text of the batch, valid until the next begin()
+  unsigned int  getCount();
+
+  static const unsigned int max_text = 622; // Particle event data limit
+  static const unsigned int max_binary = max_text / 4 * 3;
+  static const unsigned int max_records = max_binary / 7; // Every record takes at least 7 bytes
+
+private:
+/*********************************  OBJECTS  **********************************/
+  uint8_t   binary[max_binary];
+  unsigned int  length;
+  unsigned int  count;
+  LogRecord previous;
+  char      text[max_text + 1];
+};
+
+struct WireBatch {
+  uint8_t   version;
+  unsigned int  remaining;
+  uint32_t  time; // 0 if it was left out
+  unsigned int  count;
+  LogRecord records[WireEncoder::max_records]; // crc is not sent and left 0
+};
+
+bool    decodeWireBatch(const char *text, WireBatch &batch); // false if the text is not a valid batch
+
+static const uint8_t wire_version = 1;
+
+#endif